@@ -0,0 +1,609 @@
+/*  bench_uperm.cc
+
+  Google Benchmark suite for the generation and apply paths of uperm.h,
+  for N=4..14 at every level, and for the tensor kernels of 
+  uperm_tensor.h (OpenMP parallel when the build has it).
+
+  Levels with more than GEN_CAP lists (e.g. N=14, L=13 has 13! lists) are
+  measured on a GEN_CAP slice starting at the middle rank, through
+  fill_unique_permutations, rather than generated in full. The apply
+  benchmarks use the first APPLY_CAP lists of each level. The rank,
+  unrank and classify benchmarks time APPLY_CAP lists from the middle
+  rank. The unrolled static apply (C++17 builds) is timed for N=4,5,
+  and the group and distinct generators on a few fixed shapes.
+
+  Counters:
+    perms/s      lists generated (or applied) per second
+    bytes/perm   bytes stored per generated list
+    elem_bytes   sizeof(T) of the permuted elements
+    elems/s      tensor elements written per second
+
+    ./uperm_bench --benchmark_filter=generate/fill/N:12
+*/
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "uperm.h"
+#include "uperm_tensor.h"
+
+namespace {
+
+const size_t GEN_CAP = size_t(1) << 20;
+const size_t APPLY_CAP = size_t(1) << 14;
+
+struct payload64 {
+  double V[8];
+};
+
+template<typename T>
+T make_element(const size_t I) {
+  return static_cast<T>(I);
+}
+
+template<>
+payload64 make_element<payload64>(const size_t I) {
+  payload64 P;
+  for (int X=0; X < 8; X++) {
+    P.V[X] = static_cast<double>(I*8 + X);
+  }
+  return P;
+}
+
+template<typename T, int N>
+std::array<T,N> make_input() {
+  std::array<T,N> IN;
+  for (size_t I=0; I < IN.size(); I++) {
+    IN[I] = make_element<T>(I);
+  }
+  return IN;
+}
+
+void set_counters(benchmark::State& state, const size_t LISTS, const size_t BYTES_PER_LIST) {
+  state.counters["perms/s"] = benchmark::Counter(static_cast<double>(LISTS),
+                                                 benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["bytes/perm"] = static_cast<double>(BYTES_PER_LIST);
+}
+
+//the lists measured for (N,L), the whole level or its capped slice
+template<int N, int L>
+size_t first_rank(const size_t CAP) {
+  const size_t COUNT = uperm::num_unique_permutations(N,L);
+  return COUNT > CAP ? (COUNT - CAP) / 2 : 0;
+}
+
+template<int N, int L>
+size_t num_lists(const size_t CAP) {
+  return std::min(uperm::num_unique_permutations(N,L),CAP);
+}
+
+/*
+  Generation
+*/
+template<int N, int L>
+void generate_vector(benchmark::State& state) {
+  using IDX = uperm::compact_index_t<N>;
+  for (auto _ : state) {
+    auto TABLE = uperm::get_all_unique_permutations<N,L,IDX>();
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),sizeof(uperm::index_permutation_list<L,IDX>));
+}
+
+template<int N, int L>
+void generate_vector_size_t(benchmark::State& state) {
+  for (auto _ : state) {
+    auto TABLE = uperm::get_all_unique_permutations<N,L>();
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),sizeof(uperm::index_permutation_list<L>));
+}
+
+template<int N, int L>
+void generate_parallel(benchmark::State& state) {
+  using IDX = uperm::compact_index_t<N>;
+  for (auto _ : state) {
+    auto TABLE = uperm::get_all_unique_permutations_parallel<N,L,IDX>();
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),sizeof(uperm::index_permutation_list<L,IDX>));
+}
+
+template<int N, int L>
+void generate_fill(benchmark::State& state) {
+  using IDX = uperm::compact_index_t<N>;
+  const size_t FIRST = first_rank<N,L>(GEN_CAP);
+  const size_t COUNT = num_lists<N,L>(GEN_CAP);
+  uperm::index_permutation_list_vector<N,L,IDX> TABLE(COUNT);
+  for (auto _ : state) {
+    uperm::fill_unique_permutations<N,L,IDX>(FIRST,COUNT,TABLE.begin());
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,COUNT,sizeof(uperm::index_permutation_list<L,IDX>));
+}
+
+template<int N, int L>
+void generate_range(benchmark::State& state) {
+  using IDX = uperm::compact_index_t<N>;
+  const size_t COUNT = num_lists<N,L>(GEN_CAP);
+  for (auto _ : state) {
+    size_t K = 0;
+    for (auto const& PLIST : uperm::unique_permutation_range<N,L,IDX>()) {
+      benchmark::DoNotOptimize(&PLIST);
+      if (++K == COUNT) {
+        break;
+      }
+    }
+  }
+  set_counters(state,COUNT,0);
+}
+
+//the original recursive generator
+template<int N, int L>
+void generate_inner_loop(benchmark::State& state) {
+  uperm::index_permutation_list_vector<N,L> TABLE(uperm::num_unique_permutations(N,L));
+  for (auto _ : state) {
+    uperm::index_permutation_list<L> TMP{};
+    auto ELEMENT = TABLE.begin();
+    uperm::inner_permutation_loop<N,L>(L,0,0,TMP,ELEMENT);
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,TABLE.size(),sizeof(uperm::index_permutation_list<L>));
+}
+
+//the minimal change cursor, every step rebuilding the list and its delta
+template<int N, int L>
+void generate_minimal_change(benchmark::State& state) {
+  const size_t COUNT = num_lists<N,L>(GEN_CAP);
+  for (auto _ : state) {
+    size_t K = 0;
+    for (auto const& CURSOR : uperm::minimal_change_permutation_range<N,L>()) {
+      benchmark::DoNotOptimize(CURSOR.delta().DATA);
+      if (++K == COUNT) {
+        break;
+      }
+    }
+  }
+  set_counters(state,COUNT,0);
+}
+
+//the work stealing walk over the whole level, each chunk unranked
+template<int N, int L>
+void generate_work_stealing(benchmark::State& state) {
+  for (auto _ : state) {
+    uperm::parallel_for_each_permutation<N,L>([](const size_t, const uperm::index_permutation_list<L>& PLIST) {
+      benchmark::DoNotOptimize(&PLIST);
+    });
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),0);
+}
+
+//one producer generating blocks for the default number of consumers
+template<int N, int L>
+void generate_stream(benchmark::State& state) {
+  using list_type = uperm::index_permutation_list<L>;
+  for (auto _ : state) {
+    uperm::stream_unique_permutations<N,L>([](const list_type* BEGIN, const list_type*, const size_t) {
+      benchmark::DoNotOptimize(BEGIN);
+    });
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),sizeof(list_type));
+}
+
+template<int N, int L>
+void generate_unrank(benchmark::State& state) {
+  const size_t FIRST = first_rank<N,L>(APPLY_CAP);
+  const size_t COUNT = num_lists<N,L>(APPLY_CAP);
+  for (auto _ : state) {
+    for (size_t K=FIRST; K < FIRST + COUNT; K++) {
+      auto PLIST = uperm::unrank_unique_permutation<N,L>(K);
+      benchmark::DoNotOptimize(PLIST);
+    }
+  }
+  set_counters(state,COUNT,0);
+}
+
+template<int N, int L>
+void generate_rank(benchmark::State& state) {
+  const size_t COUNT = num_lists<N,L>(APPLY_CAP);
+  uperm::index_permutation_list_vector<N,L> TABLE(COUNT);
+  uperm::fill_unique_permutations<N,L>(first_rank<N,L>(APPLY_CAP),COUNT,TABLE.begin());
+  for (auto _ : state) {
+    for (auto const& PLIST : TABLE) {
+      benchmark::DoNotOptimize(uperm::rank_unique_permutation<N,L>(PLIST));
+    }
+  }
+  set_counters(state,COUNT,0);
+}
+
+//level and rank recovered from composed index arrays
+template<int N, int L>
+void generate_classify(benchmark::State& state) {
+  const size_t COUNT = num_lists<N,L>(APPLY_CAP);
+  uperm::index_permutation_list_vector<N,L> TABLE(COUNT);
+  uperm::fill_unique_permutations<N,L>(first_rank<N,L>(APPLY_CAP),COUNT,TABLE.begin());
+  uperm::index_map_vector<N,L> MAPS(COUNT);
+  for (size_t K=0; K < COUNT; K++) {
+    MAPS[K] = uperm::compose_index_map<N,L>(TABLE[K]);
+  }
+  for (auto _ : state) {
+    for (auto const& MAP : MAPS) {
+      benchmark::DoNotOptimize(uperm::classify_permutation(MAP));
+    }
+  }
+  set_counters(state,COUNT,0);
+}
+
+template<int N, int L>
+void generate_index_maps(benchmark::State& state) {
+  for (auto _ : state) {
+    auto MAPS = uperm::get_all_unique_index_maps<N,L>();
+    benchmark::DoNotOptimize(MAPS.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),sizeof(uperm::index_map<N>));
+}
+
+/*
+  Apply, over the first APPLY_CAP lists of the level
+*/
+template<int N, int L>
+uperm::index_permutation_list_vector<N,L> apply_table() {
+  uperm::index_permutation_list_vector<N,L> TABLE(num_lists<N,L>(APPLY_CAP));
+  uperm::fill_unique_permutations<N,L>(0,TABLE.size(),TABLE.begin());
+  return TABLE;
+}
+
+template<int N, int L, typename T>
+void apply_execute(benchmark::State& state) {
+  const auto TABLE = apply_table<N,L>();
+  const std::array<T,N> IN = make_input<T,N>();
+  for (auto _ : state) {
+    for (auto const& PLIST : TABLE) {
+      auto OUT = uperm::execute_permutations<std::array<T,N>,L>(PLIST,IN);
+      benchmark::DoNotOptimize(OUT);
+    }
+  }
+  set_counters(state,TABLE.size(),0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+
+template<int N, int L, typename T>
+void apply_inplace(benchmark::State& state) {
+  const auto TABLE = apply_table<N,L>();
+  std::array<T,N> DATA = make_input<T,N>();
+  for (auto _ : state) {
+    uperm::for_each_permutation(TABLE,DATA,
+      [](const std::array<T,N>& PERMUTED, const uperm::index_permutation_list<L>&) {
+        benchmark::DoNotOptimize(&PERMUTED);
+      });
+  }
+  set_counters(state,TABLE.size(),0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+
+template<int N, int L, typename T>
+void apply_index_map(benchmark::State& state) {
+  const auto TABLE = apply_table<N,L>();
+  uperm::index_map_vector<N,L> MAPS(TABLE.size());
+  for (size_t K=0; K < TABLE.size(); K++) {
+    MAPS[K] = uperm::compose_index_map<N,L>(TABLE[K]);
+  }
+  const std::array<T,N> IN = make_input<T,N>();
+  for (auto _ : state) {
+    for (auto const& MAP : MAPS) {
+      auto OUT = uperm::apply_index_map<T,N>(MAP,IN);
+      benchmark::DoNotOptimize(OUT);
+    }
+  }
+  set_counters(state,MAPS.size(),0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+
+//the whole level by the prefix sharing tree walk
+template<int N, int L, typename T>
+void apply_all(benchmark::State& state) {
+  std::array<T,N> DATA = make_input<T,N>();
+  for (auto _ : state) {
+    uperm::apply_all_permutations<N,L>(DATA,
+      [](const std::array<T,N>& PERMUTED, const uperm::index_permutation_list<L>&) {
+        benchmark::DoNotOptimize(&PERMUTED);
+      });
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+
+//a running copy updated by the minimal change deltas
+template<int N, int L, typename T>
+void apply_minimal_change(benchmark::State& state) {
+  const size_t COUNT = num_lists<N,L>(APPLY_CAP);
+  std::array<T,N> DATA = make_input<T,N>();
+  for (auto _ : state) {
+    size_t K = 0;
+    for (auto const& CURSOR : uperm::minimal_change_permutation_range<N,L>()) {
+      uperm::execute_permutations_inplace(CURSOR.delta(),DATA);
+      benchmark::DoNotOptimize(&DATA);
+      if (++K == COUNT) {
+        break;
+      }
+    }
+  }
+  set_counters(state,COUNT,0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+
+//cycle form apply and undo in place, by moves only
+template<int N, int L, typename T>
+void apply_cycles(benchmark::State& state) {
+  const auto TABLE = apply_table<N,L>();
+  uperm::permutation_cycles_vector<N,L> CYCLES(TABLE.size());
+  for (size_t K=0; K < TABLE.size(); K++) {
+    CYCLES[K] = uperm::compose_permutation_cycles<N,L>(TABLE[K]);
+  }
+  std::array<T,N> DATA = make_input<T,N>();
+  for (auto _ : state) {
+    for (auto const& C : CYCLES) {
+      uperm::execute_permutations_inplace(C,DATA);
+      benchmark::DoNotOptimize(&DATA);
+      uperm::undo_permutations_inplace(C,DATA);
+    }
+  }
+  set_counters(state,CYCLES.size(),0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+
+//one new input per iteration: the slot pass, then every list from its slot
+template<int N, int L, typename T>
+void apply_prefix_cache(benchmark::State& state) {
+  const auto TABLE = apply_table<N,L>();
+  uperm::permutation_prefix_cache<std::array<T,N>> CACHE(TABLE,size_t(1) << 20);
+  const std::array<T,N> IN = make_input<T,N>();
+  for (auto _ : state) {
+    CACHE.set_input(IN);
+    CACHE.for_each([](const size_t, const std::array<T,N>& PERMUTED) {
+      benchmark::DoNotOptimize(&PERMUTED);
+    });
+  }
+  set_counters(state,CACHE.size(),0);
+  state.counters["elem_bytes"] = sizeof(T);
+  state.counters["depth"] = static_cast<double>(CACHE.depth());
+}
+
+#if __cplusplus >= 201703L
+//the whole level fully unrolled, one constant gather per list
+template<int N, int L, typename T>
+void apply_static(benchmark::State& state) {
+  const std::array<T,N> IN = make_input<T,N>();
+  for (auto _ : state) {
+    uperm::apply_all_permutations_static<N,L>(IN,
+      [](const std::array<T,N>& PERMUTED, const uperm::index_permutation_list<L>&) {
+        benchmark::DoNotOptimize(&PERMUTED);
+      });
+  }
+  set_counters(state,uperm::num_unique_permutations(N,L),0);
+  state.counters["elem_bytes"] = sizeof(T);
+}
+#endif
+
+//a batch of B rows per list, N x B column major
+template<int N, int L>
+void apply_batched(benchmark::State& state) {
+  const size_t B = 256;
+  const auto TABLE = apply_table<N,L>();
+  std::vector<double> IN(N*B);
+  std::vector<double> OUT(N*B);
+  for (size_t I=0; I < IN.size(); I++) {
+    IN[I] = static_cast<double>(I);
+  }
+  for (auto _ : state) {
+    for (auto const& PLIST : TABLE) {
+      uperm::execute_permutations_batched<N>(PLIST,IN.data(),OUT.data(),B);
+      benchmark::DoNotOptimize(OUT.data());
+      benchmark::ClobberMemory();
+    }
+  }
+  set_counters(state,TABLE.size()*B,0);
+  state.counters["elem_bytes"] = sizeof(double);
+}
+
+/*
+  Tensor kernels, on D^N tensors of doubles
+*/
+template<int N>
+size_t tensor_size(const size_t D) {
+  size_t S = 1;
+  for (int K=0; K < N; K++) {
+    S *= D;
+  }
+  return S;
+}
+
+template<int N>
+void tensor_antisymmetrize(benchmark::State& state) {
+  const size_t D = static_cast<size_t>(state.range(0));
+  std::vector<double> IN(tensor_size<N>(D));
+  std::vector<double> OUT(IN.size());
+  for (size_t I=0; I < IN.size(); I++) {
+    IN[I] = static_cast<double>(I % 97);
+  }
+  for (auto _ : state) {
+    uperm::antisymmetrize_accumulate<N>(IN.data(),OUT.data(),D);
+    benchmark::DoNotOptimize(OUT.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["elems/s"] = benchmark::Counter(static_cast<double>(OUT.size()),
+                                                 benchmark::Counter::kIsIterationInvariantRate);
+}
+
+//the last list of level N-1, which moves every axis
+template<int N>
+void tensor_transpose(benchmark::State& state) {
+  const size_t D = static_cast<size_t>(state.range(0));
+  const auto PLIST = uperm::unrank_unique_permutation<N,N-1>(uperm::num_unique_permutations(N,N-1) - 1);
+  std::array<size_t,N> EXTENTS;
+  EXTENTS.fill(D);
+  std::vector<double> IN(tensor_size<N>(D));
+  std::vector<double> OUT(IN.size());
+  for (size_t I=0; I < IN.size(); I++) {
+    IN[I] = static_cast<double>(I);
+  }
+  for (auto _ : state) {
+    uperm::transpose_axes<N>(PLIST,IN.data(),EXTENTS,OUT.data());
+    benchmark::DoNotOptimize(OUT.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["elems/s"] = benchmark::Counter(static_cast<double>(OUT.size()),
+                                                 benchmark::Counter::kIsIterationInvariantRate);
+}
+
+/*
+  Restricted generation, on fixed shapes given by name
+*/
+const std::vector<std::vector<size_t>> RESTRICTED_GROUPS[] = {
+  {{0,1,2,3},{4,5,6,7}},
+  {{0,1,2,3,4,5},{6,7,8,9,10,11}},
+};
+const std::vector<size_t> RESTRICTED_LEVELS[] = {{2,2},{3,3}};
+const std::vector<size_t> DISTINCT_CLASSES[] = {
+  {0,0,1,1,2,2,3,3},
+  {0,0,0,1,1,1,2,2,2,3},
+};
+
+void generate_group(benchmark::State& state, const size_t S) {
+  size_t L = 0;
+  for (const size_t LEVEL : RESTRICTED_LEVELS[S]) {
+    L += LEVEL;
+  }
+  for (auto _ : state) {
+    auto TABLE = uperm::get_group_unique_permutations(RESTRICTED_GROUPS[S],RESTRICTED_LEVELS[S]);
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,uperm::num_group_unique_permutations(RESTRICTED_GROUPS[S],RESTRICTED_LEVELS[S]),
+               L*sizeof(uperm::index_permutation));
+}
+
+void generate_distinct(benchmark::State& state, const size_t S, const size_t L) {
+  size_t COUNT = 0;
+  for (auto _ : state) {
+    auto TABLE = uperm::get_distinct_unique_permutations(DISTINCT_CLASSES[S],L);
+    COUNT = TABLE.size();
+    benchmark::DoNotOptimize(TABLE.data());
+    benchmark::ClobberMemory();
+  }
+  set_counters(state,COUNT,L*sizeof(uperm::index_permutation));
+}
+
+void register_restricted() {
+  benchmark::RegisterBenchmark("generate/group/N:8/L:2+2",generate_group,size_t(0));
+  benchmark::RegisterBenchmark("generate/group/N:12/L:3+3",generate_group,size_t(1));
+  benchmark::RegisterBenchmark("generate/distinct/N:8/L:3",generate_distinct,size_t(0),size_t(3));
+  benchmark::RegisterBenchmark("generate/distinct/N:8/L:5",generate_distinct,size_t(0),size_t(5));
+  benchmark::RegisterBenchmark("generate/distinct/N:10/L:4",generate_distinct,size_t(1),size_t(4));
+  benchmark::RegisterBenchmark("generate/distinct/N:10/L:6",generate_distinct,size_t(1),size_t(6));
+}
+
+void register_tensor() {
+  benchmark::RegisterBenchmark("tensor/antisymmetrize/N:3",tensor_antisymmetrize<3>)->Arg(64)->Arg(256);
+  benchmark::RegisterBenchmark("tensor/antisymmetrize/N:4",tensor_antisymmetrize<4>)->Arg(16)->Arg(48);
+  benchmark::RegisterBenchmark("tensor/antisymmetrize/N:5",tensor_antisymmetrize<5>)->Arg(12);
+  benchmark::RegisterBenchmark("tensor/transpose/N:3",tensor_transpose<3>)->Arg(64)->Arg(256);
+  benchmark::RegisterBenchmark("tensor/transpose/N:4",tensor_transpose<4>)->Arg(16)->Arg(64);
+}
+
+/*
+  Registration, one set of benchmarks per (N,L)
+*/
+template<int N, int L>
+std::string bench_name(const char* WHAT, const char* T = NULL) {
+  std::string NAME = std::string(WHAT) + "/N:" + std::to_string(N) + "/L:" + std::to_string(L);
+  if (T != NULL) {
+    NAME += std::string("/T:") + T;
+  }
+  return NAME;
+}
+
+template<int N, int L, typename T>
+void register_apply(const char* T_NAME) {
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/execute",T_NAME).c_str(),apply_execute<N,L,T>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/inplace",T_NAME).c_str(),apply_inplace<N,L,T>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/index_map",T_NAME).c_str(),apply_index_map<N,L,T>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/minimal_change",T_NAME).c_str(),apply_minimal_change<N,L,T>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/cycles",T_NAME).c_str(),apply_cycles<N,L,T>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/prefix_cache",T_NAME).c_str(),apply_prefix_cache<N,L,T>);
+  if (uperm::num_unique_permutations(N,L) <= GEN_CAP) {
+    benchmark::RegisterBenchmark(bench_name<N,L>("apply/apply_all",T_NAME).c_str(),apply_all<N,L,T>);
+  }
+}
+
+template<int N, int L>
+void register_level() {
+  const bool FULL = uperm::num_unique_permutations(N,L) <= GEN_CAP;
+  if (FULL) {
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/vector").c_str(),generate_vector<N,L>);
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/vector_size_t").c_str(),generate_vector_size_t<N,L>);
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/parallel").c_str(),generate_parallel<N,L>);
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/index_maps").c_str(),generate_index_maps<N,L>);
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/inner_loop").c_str(),generate_inner_loop<N,L>);
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/work_stealing").c_str(),generate_work_stealing<N,L>);
+    benchmark::RegisterBenchmark(bench_name<N,L>("generate/stream").c_str(),generate_stream<N,L>);
+  }
+  benchmark::RegisterBenchmark(bench_name<N,L>("generate/fill").c_str(),generate_fill<N,L>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("generate/range").c_str(),generate_range<N,L>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("generate/minimal_change").c_str(),generate_minimal_change<N,L>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("generate/unrank").c_str(),generate_unrank<N,L>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("generate/rank").c_str(),generate_rank<N,L>);
+  benchmark::RegisterBenchmark(bench_name<N,L>("generate/classify").c_str(),generate_classify<N,L>);
+
+  register_apply<N,L,uint8_t>("u8");
+  register_apply<N,L,double>("f64");
+  register_apply<N,L,payload64>("b64");
+  benchmark::RegisterBenchmark(bench_name<N,L>("apply/batched","f64").c_str(),apply_batched<N,L>);
+}
+
+template<int N, size_t... LS>
+void register_levels(std::index_sequence<LS...>) {
+  const int DUMMY[] = {0, (register_level<N,static_cast<int>(LS)>(), 0)...};
+  (void)DUMMY;
+}
+
+#if __cplusplus >= 201703L
+template<int N, size_t... LS>
+void register_static(std::index_sequence<LS...>) {
+  (benchmark::RegisterBenchmark(bench_name<N,static_cast<int>(LS)>("apply/static","f64").c_str(),
+                                apply_static<N,static_cast<int>(LS),double>), ...);
+}
+#endif
+
+template<size_t... NS>
+void register_all(std::index_sequence<NS...>) {
+  const int DUMMY[] = {0, (register_levels<static_cast<int>(NS) + 4>(std::make_index_sequence<NS + 4>()), 0)...};
+  (void)DUMMY;
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char** argv) {
+  register_all(std::make_index_sequence<14 - 4 + 1>());
+#if __cplusplus >= 201703L
+  register_static<4>(std::make_index_sequence<4>());
+  register_static<5>(std::make_index_sequence<5>());
+#endif
+  register_restricted();
+  register_tensor();
+  benchmark::Initialize(&argc,argv);
+  if (benchmark::ReportUnrecognizedArguments(argc,argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,896 @@
+/*  test_uperm.cc
+
+  Behaviour checks for the engines of uperm.h, uperm_mmap.h and
+  uperm_tensor.h. Every engine is compared against the reference path,
+  get_all_unique_permutations<N,L> and execute_permutations, which is
+  itself checked against a brute force enumeration of the level L lists,
+  for N=1..7 at every level.
+
+  Prints each failed check and exits non zero if there was any, run by
+  ctest as uperm_test.
+*/
+
+//the counters are checked below, and every engine is instantiated with them
+#define UPERM_ENABLE_STATS
+
+#include <stdio.h>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "uperm.h"
+#include "uperm_mmap.h"
+#include "uperm_tensor.h"
+
+namespace {
+
+size_t FAILURES = 0;
+
+#define CHECK(...) \
+  do { \
+    if (!(__VA_ARGS__)) { \
+      printf("%s:%d: check failed: %s\n",__FILE__,__LINE__,#__VA_ARGS__); \
+      fflush(stdout); \
+      FAILURES++; \
+    } \
+  } while (0)
+
+template<typename A, typename B>
+bool same_list(const A& PA, const B& PB) {
+  if (PA.size() != PB.size()) {
+    return false;
+  }
+  for (size_t X=0; X < PA.size(); X++) {
+    if (PA[X].first != PB[X].first || PA[X].second != PB[X].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//list K of A equals list FIRST+K of B, for every list of A
+template<typename TA, typename TB>
+bool same_lists(const TA& A, const TB& B, const size_t FIRST = 0) {
+  if (FIRST + A.size() > B.size()) {
+    return false;
+  }
+  for (size_t K=0; K < A.size(); K++) {
+    if (!same_list(A[K],B[FIRST + K])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<int N>
+std::array<int,N> iota_array() {
+  std::array<int,N> A;
+  for (size_t I=0; I < A.size(); I++) {
+    A[I] = static_cast<int>(I);
+  }
+  return A;
+}
+
+/*
+  brute force reference: every list of L swaps (I_x,J_x) with strictly
+  increasing LHS indices I_x < J_x, in lexicographic order
+*/
+void brute_force_lists(const size_t N, const size_t L, const size_t X, const size_t MIN,
+                       std::vector<uperm::index_permutation>& TMP,
+                       std::vector<std::vector<uperm::index_permutation>>& OUT) {
+  if (X == L) {
+    OUT.push_back(TMP);
+    return;
+  }
+  for (size_t I=MIN; I + 1 < N; I++) {
+    for (size_t J=I+1; J < N; J++) {
+      TMP[X] = {I,J};
+      brute_force_lists(N,L,X+1,I+1,TMP,OUT);
+    }
+  }
+}
+
+/*
+  Generation, ranking and apply paths of one (N,L)
+*/
+template<int N, int L>
+void check_level() {
+  using list_type = uperm::index_permutation_list<L>;
+  const auto TABLE = uperm::get_all_unique_permutations<N,L>();
+  const size_t COUNT = TABLE.size();
+  const std::array<int,N> IN = iota_array<N>();
+
+  //reference against brute force
+  std::vector<std::vector<uperm::index_permutation>> BRUTE;
+  std::vector<uperm::index_permutation> TMP(L);
+  brute_force_lists(N,L,0,0,TMP,BRUTE);
+  CHECK(COUNT == uperm::num_unique_permutations(N,L));
+  CHECK(COUNT == BRUTE.size());
+  size_t CHECKED = 0;
+  for (size_t K=0; K < std::min(COUNT,BRUTE.size()); K++) {
+    CHECKED += same_list(TABLE[K],BRUTE[K]) ? 1 : 0;
+  }
+  CHECK(CHECKED == COUNT);
+  size_t COUNT_DP = 0;
+  CHECK(uperm::num_unique_permutations_checked(N,L,COUNT_DP) && COUNT_DP == COUNT);
+
+  //distinct outputs, one per list
+  std::set<std::array<int,N>> OUTPUTS;
+  for (auto const& PLIST : TABLE) {
+    OUTPUTS.insert(uperm::execute_permutations<std::array<int,N>,L>(PLIST,IN));
+  }
+  CHECK(OUTPUTS.size() == COUNT);
+
+  //compact indices, runtime N and L, parallel generation
+  const auto COMPACT = uperm::get_all_unique_permutations<N,L,uperm::compact_index_t<N>>();
+  const auto RUNTIME = uperm::get_all_unique_permutations<uint16_t>(N,L);
+  const auto PARALLEL = uperm::get_all_unique_permutations_parallel<N,L,uint8_t>(3);
+  CHECK(COMPACT.size() == COUNT && RUNTIME.size() == COUNT && PARALLEL.size() == COUNT);
+  for (size_t K=0; K < COUNT; K++) {
+    CHECK(same_list(COMPACT[K],TABLE[K]));
+    CHECK(same_list(RUNTIME[K],TABLE[K]));
+    CHECK(same_list(PARALLEL[K],TABLE[K]));
+  }
+
+  const auto LEVELS = uperm::get_all_unique_permutation_levels<N>();
+  const auto LEVEL = LEVELS.level(L);
+  CHECK(LEVEL.size() == COUNT);
+  for (size_t K=0; K < COUNT && L > 0; K++) {
+    CHECK(same_list(LEVEL[K],TABLE[K]));
+  }
+
+  //caller supplied storage
+  uperm::index_permutation_list_vector<N,L> REUSED(3);
+  uperm::get_all_unique_permutations<N,L>(REUSED);
+  CHECK(same_lists(REUSED,TABLE) && REUSED.size() == COUNT);
+  std::vector<list_type> BUFFER(COUNT + 1);
+  CHECK(uperm::get_all_unique_permutations<N,L,size_t>(BUFFER.data(),COUNT) == COUNT);
+  CHECK(same_lists(TABLE,BUFFER));
+  if (COUNT > 1) {
+    BUFFER.assign(COUNT,list_type{});
+    CHECK(uperm::get_all_unique_permutations<N,L,size_t>(BUFFER.data(),COUNT - 1) == COUNT);
+    CHECK(same_list(BUFFER[0],list_type{}) || L == 0);
+  }
+
+  //lazy ranges, slices, rank and unrank
+  size_t K = 0;
+  for (auto const& PLIST : uperm::unique_permutation_range<N,L>()) {
+    CHECK(K < COUNT && same_list(PLIST,TABLE[K]));
+    K++;
+  }
+  CHECK(K == COUNT);
+  //the iterator stashes its list, so it only promises single pass input
+  using range_iterator = typename uperm::unique_permutation_range<N,L>::iterator;
+  static_assert(std::is_same<typename std::iterator_traits<range_iterator>::iterator_category,
+                             std::input_iterator_tag>::value, "stashing iterators are input iterators");
+  const uperm::unique_permutation_range<N,L> LAZY;
+  const std::vector<list_type> COPIED(LAZY.begin(),LAZY.end());
+  CHECK(COPIED.size() == COUNT && same_lists(COPIED,TABLE));
+  const size_t MID = COUNT / 2;
+  K = MID;
+  for (auto const& PLIST : uperm::unique_permutation_range<N,L>(MID,COUNT + 5)) {
+    CHECK(K < COUNT && same_list(PLIST,TABLE[K]));
+    K++;
+  }
+  CHECK(K == COUNT);
+  CHECK(uperm::unique_permutation_range<N,L>(COUNT + 1,COUNT + 9).empty());
+  for (K=0; K < COUNT; K++) {
+    CHECK(same_list(uperm::unrank_unique_permutation<N,L>(K),TABLE[K]));
+    CHECK(uperm::rank_unique_permutation<N,L>(TABLE[K]) == K);
+  }
+  std::vector<list_type> SLICE;
+  uperm::fill_unique_permutations<N,L>(MID,COUNT - MID,std::back_inserter(SLICE));
+  CHECK(same_lists(SLICE,TABLE,MID) && SLICE.size() == COUNT - MID);
+
+  //classification of the permuted index arrays
+  for (K=0; K < COUNT; K++) {
+    const uperm::permutation_class C =
+      uperm::classify_permutation(uperm::execute_permutations<std::array<int,N>,L>(TABLE[K],IN));
+    CHECK(C.level == static_cast<size_t>(L) && C.rank == K);
+  }
+
+  //index maps, the prefix sharing walks, in place and cycle application
+  const auto MAPS = uperm::get_all_unique_index_maps<N,L>();
+  CHECK(MAPS.size() == COUNT);
+  for (K=0; K < COUNT; K++) {
+    CHECK(MAPS[K] == uperm::compose_index_map<N,L>(TABLE[K]));
+    const auto REF = uperm::execute_permutations<std::array<int,N>,L>(TABLE[K],IN);
+    CHECK((uperm::apply_index_map<int,N>(MAPS[K],IN) == REF));
+
+    std::array<int,N> DATA = IN;
+    const auto CYCLES = uperm::compose_permutation_cycles<N,L>(TABLE[K]);
+    uperm::execute_permutations_inplace(CYCLES,DATA);
+    CHECK(DATA == REF);
+    uperm::undo_permutations_inplace(CYCLES,DATA);
+    CHECK(DATA == IN);
+
+    std::array<std::unique_ptr<int>,N> OWNED;
+    for (size_t I=0; I < OWNED.size(); I++) {
+      OWNED[I].reset(new int(static_cast<int>(I)));
+    }
+    uperm::execute_permutations_inplace(CYCLES,OWNED);
+    bool MOVED = true;
+    for (size_t I=0; I < OWNED.size(); I++) {
+      MOVED = MOVED && OWNED[I] && *OWNED[I] == REF[I];
+    }
+    CHECK(MOVED);
+  }
+
+  std::vector<std::array<int,N>> WALK;
+  std::array<int,N> DATA = IN;
+  uperm::apply_all_permutations<N,L>(DATA,[&WALK](const std::array<int,N>& P, const list_type&) {
+    WALK.push_back(P);
+  });
+  std::vector<std::array<int,N>> RUNTIME_WALK;
+  uperm::apply_all_permutations(N,L,DATA,[&RUNTIME_WALK](const std::array<int,N>& P,
+                                                         const uperm::index_permutation_span<size_t>&) {
+    RUNTIME_WALK.push_back(P);
+  });
+  std::vector<std::array<int,N>> INPLACE;
+  uperm::for_each_permutation<N,L>(DATA,[&INPLACE](const std::array<int,N>& P, const list_type&) {
+    INPLACE.push_back(P);
+  });
+  CHECK(DATA == IN);
+  CHECK(WALK.size() == COUNT && RUNTIME_WALK.size() == COUNT && INPLACE.size() == COUNT);
+  for (K=0; K < std::min(COUNT,std::min(WALK.size(),std::min(RUNTIME_WALK.size(),INPLACE.size()))); K++) {
+    const auto REF = uperm::execute_permutations<std::array<int,N>,L>(TABLE[K],IN);
+    CHECK(WALK[K] == REF && RUNTIME_WALK[K] == REF && INPLACE[K] == REF);
+  }
+
+  //prefix cache, with room for no slot, a few slots and all of them
+  for (const size_t CAP : {size_t(0), 4*sizeof(std::array<int,N>), size_t(1) << 20}) {
+    uperm::permutation_prefix_cache<std::array<int,N>> CACHE(TABLE,CAP);
+    CACHE.set_input(IN);
+    size_t VISITED = 0;
+    CACHE.for_each([&TABLE,&IN,&VISITED](const size_t KK, const std::array<int,N>& P) {
+      CHECK((P == uperm::execute_permutations<std::array<int,N>,L>(TABLE[KK],IN)));
+      VISITED++;
+    });
+    CHECK(VISITED == COUNT);
+    for (K=0; K < COUNT; K++) {
+      CHECK((CACHE.execute(K) == uperm::execute_permutations<std::array<int,N>,L>(TABLE[K],IN)));
+    }
+  }
+
+  //batched columns
+  const size_t B = 5;
+  std::vector<double> COLUMNS(N*B);
+  for (size_t I=0; I < COLUMNS.size(); I++) {
+    COLUMNS[I] = static_cast<double>(I);
+  }
+  std::vector<double> BATCH(COUNT*N*B);
+  uperm::execute_all_permutations_batched<N>(TABLE,COLUMNS.data(),BATCH.data(),B);
+  for (K=0; K < COUNT; K++) {
+    for (size_t R=0; R < B; R++) {
+      std::array<double,N> ROW;
+      for (size_t C=0; C < ROW.size(); C++) {
+        ROW[C] = COLUMNS[C*B + R];
+      }
+      ROW = uperm::execute_permutations<std::array<double,N>,L>(TABLE[K],ROW);
+      for (size_t C=0; C < ROW.size(); C++) {
+        CHECK(BATCH[K*N*B + C*B + R] == ROW[C]);
+      }
+    }
+  }
+
+  //minimal change order: every list once, deltas of at most two swaps
+  std::set<size_t> SEEN;
+  std::array<int,N> RUNNING = IN;
+  size_t STEPS = 0;
+  for (auto const& CURSOR : uperm::minimal_change_permutation_range<N,L>()) {
+    SEEN.insert(uperm::rank_unique_permutation<N,L>(CURSOR.permutation()));
+    uperm::execute_permutations_inplace(CURSOR.delta(),RUNNING);
+    CHECK((RUNNING == uperm::execute_permutations<std::array<int,N>,L>(CURSOR.permutation(),IN)));
+    CHECK(STEPS == 0 || CURSOR.delta().size() <= 2);
+    STEPS++;
+  }
+  CHECK(STEPS == COUNT && SEEN.size() == COUNT);
+
+  //work stealing and streaming
+  std::vector<std::atomic<int>> HITS(COUNT);
+  for (auto& hit : HITS) {
+    hit.store(0);
+  }
+  uperm::parallel_for_each_permutation<N,L>([&HITS,&TABLE](const size_t KK, const list_type& PLIST) {
+    CHECK(same_list(PLIST,TABLE[KK]));
+    HITS[KK]++;
+  },4,1);
+  size_t ONCE = 0;
+  for (auto& hit : HITS) {
+    ONCE += (hit.load() == 1) ? 1 : 0;
+  }
+  CHECK(ONCE == COUNT);
+
+  std::vector<std::array<int,N>> PARALLEL_OUT(COUNT);
+  uperm::parallel_execute_permutations(TABLE,IN,PARALLEL_OUT,3,2);
+  for (K=0; K < COUNT; K++) {
+    CHECK((PARALLEL_OUT[K] == uperm::execute_permutations<std::array<int,N>,L>(TABLE[K],IN)));
+  }
+
+  for (const size_t BLOCK_SIZE : {size_t(0), size_t(1), size_t(7), size_t(4096)}) {
+    std::mutex LOCK;
+    size_t STREAMED = 0;
+    bool IN_ORDER = true;
+    uperm::stream_unique_permutations<N,L>([&](const list_type* BEGIN, const list_type* END, const size_t FIRST) {
+      std::lock_guard<std::mutex> GUARD(LOCK);
+      for (const list_type* P=BEGIN; P != END; ++P) {
+        IN_ORDER = IN_ORDER && FIRST + (P - BEGIN) < COUNT && same_list(*P,TABLE[FIRST + (P - BEGIN)]);
+      }
+      STREAMED += END - BEGIN;
+    },3,BLOCK_SIZE,2);
+    CHECK(IN_ORDER && STREAMED == COUNT);
+  }
+
+  //partitions tile the level
+  for (const size_t NRANKS : {size_t(1), size_t(3), size_t(1000)}) {
+    size_t AT = 0;
+    size_t AT_WEIGHTED = 0;
+    for (size_t RANK=0; RANK < NRANKS; RANK++) {
+      const uperm::rank_range R = uperm::partition_unique_permutations<N,L>(RANK,NRANKS);
+      const uperm::rank_range W = uperm::partition_unique_permutations_weighted<N,L>(
+        [](const uperm::rank_range& BLOCK) {return BLOCK.size();},RANK,NRANKS);
+      CHECK(R.begin == AT && W.begin == AT_WEIGHTED);
+      AT = R.end;
+      AT_WEIGHTED = W.end;
+      const auto RANGE = uperm::get_unique_permutations_range<N,L>(R);
+      CHECK(RANGE.size() == R.size() && same_lists(RANGE,TABLE,R.begin));
+    }
+    CHECK(AT == COUNT && AT_WEIGHTED == COUNT);
+  }
+  CHECK(uperm::partition_ranks(COUNT,0,0).size() == 0);
+
+#if __cplusplus >= 201703L
+  //compile-time tables and the unrolled apply
+  CHECK(same_lists(TABLE,uperm::unique_permutation_table<N,L>));
+  //the unrolled apply is only meant for small levels, keep the instantiations cheap
+  if constexpr (N <= 5) {
+    K = 0;
+    uperm::apply_all_permutations_static<N,L>(IN,[&K,&TABLE,&IN](const std::array<int,N>& P, const list_type& PLIST) {
+      CHECK(same_list(PLIST,TABLE[K]) &&
+            (P == uperm::execute_permutations<std::array<int,N>,L>(TABLE[K],IN)));
+      K++;
+    });
+    CHECK(K == COUNT);
+  }
+#endif
+}
+
+template<int N, size_t... LS>
+void check_levels(std::index_sequence<LS...>) {
+  const int DUMMY[] = {0, (check_level<N,static_cast<int>(LS)>(), 0)...};
+  (void)DUMMY;
+}
+
+template<size_t... NS>
+void check_all_levels(std::index_sequence<NS...>) {
+  const int DUMMY[] = {0, (check_levels<static_cast<int>(NS) + 1>(std::make_index_sequence<NS + 1>()), 0)...};
+  (void)DUMMY;
+}
+
+/*
+  runtime rank/unrank beyond the tables, and the cut over to the generic
+  runtime loops above UPERM_DISPATCH_MAX_N
+*/
+void check_runtime() {
+  const size_t N = UPERM_DISPATCH_MAX_N + 2;
+  for (size_t L=0; L < 4; L++) {
+    const auto TABLE = uperm::get_all_unique_permutations<size_t>(N,L);
+    std::vector<std::vector<uperm::index_permutation>> BRUTE;
+    std::vector<uperm::index_permutation> TMP(L);
+    brute_force_lists(N,L,0,0,TMP,BRUTE);
+    CHECK(TABLE.size() == BRUTE.size());
+    for (size_t K=0; K < std::min(TABLE.size(),BRUTE.size()); K++) {
+      CHECK(same_list(TABLE[K],BRUTE[K]));
+    }
+  }
+
+  //the per block count table of device kernels gives the same lists and ranks
+  std::vector<size_t> COUNTS(41*21);
+  uperm::fill_unique_permutation_counts(40,20,COUNTS.data());
+  for (const size_t K : {size_t(0), size_t(123456789), size_t(987654321987ull)}) {
+    uperm::index_permutation PLIST[20];
+    uperm::index_permutation FROM_TABLE[20];
+    uperm::unrank_unique_permutation(40,20,K,PLIST);
+    uperm::unrank_unique_permutation(40,20,K,FROM_TABLE,COUNTS.data());
+    CHECK(uperm::rank_unique_permutation(40,20,PLIST) == K);
+    CHECK(uperm::rank_unique_permutation(40,20,FROM_TABLE,COUNTS.data()) == K);
+    CHECK(same_list(std::vector<uperm::index_permutation>(PLIST,PLIST + 20),
+                    std::vector<uperm::index_permutation>(FROM_TABLE,FROM_TABLE + 20)));
+  }
+  for (size_t SN=1; SN <= 9; SN++) {
+    for (size_t SL=0; SL < SN; SL++) {
+      std::vector<size_t> SMALL((SN + 1)*(SL + 1));
+      uperm::fill_unique_permutation_counts(SN,SL,SMALL.data());
+      const size_t COUNT = uperm::num_unique_permutations(SN,SL);
+      CHECK(SMALL.back() == COUNT);
+      std::vector<uperm::index_permutation> PLIST(SL);
+      bool SAME = true;
+      for (size_t K=0; K < COUNT; K += 1 + COUNT / 97) {
+        uperm::unrank_unique_permutation(SN,SL,K,PLIST.data(),SMALL.data());
+        SAME = SAME && uperm::rank_unique_permutation(SN,SL,PLIST.data()) == K &&
+               uperm::rank_unique_permutation(SN,SL,PLIST.data(),SMALL.data()) == K;
+      }
+      CHECK(SAME);
+    }
+  }
+}
+
+//a level large enough that every worker of the parallel generator gets its own range
+void check_parallel() {
+  constexpr int N = 10;
+  constexpr int L = 4;
+  const unsigned NTHREADS = 3;
+  const auto SERIAL = uperm::get_all_unique_permutations<N,L,uint8_t>();
+  CHECK(SERIAL.size() >= 2*4096*NTHREADS);
+
+  auto PARALLEL = uperm::get_all_unique_permutations_parallel<N,L,uint8_t>(NTHREADS);
+  static_assert(std::is_same<decltype(PARALLEL),uperm::index_permutation_list_vector<N,L,uint8_t>>::value,
+                "the parallel table has the serial type");
+  CHECK(PARALLEL.size() == SERIAL.size() && same_lists(PARALLEL,SERIAL));
+
+  uperm::uninitialized_index_permutation_list_vector<N,L,uint8_t> FIRST_TOUCH;
+  uperm::get_all_unique_permutations_parallel<N,L>(FIRST_TOUCH,NTHREADS);
+  CHECK(FIRST_TOUCH.size() == SERIAL.size() && same_lists(FIRST_TOUCH,SERIAL));
+  PARALLEL.assign(5,{});
+  uperm::get_all_unique_permutations_parallel<N,L>(PARALLEL,NTHREADS);
+  CHECK(PARALLEL.size() == SERIAL.size() && same_lists(PARALLEL,SERIAL));
+}
+
+//SIMD widths of apply_index_map, against the scalar gather
+template<class T, int N>
+void check_index_map_width() {
+  uperm::index_map<N> MAP;
+  std::array<T,N> IN;
+  for (size_t I=0; I < MAP.size(); I++) {
+    MAP[I] = static_cast<uint8_t>((I*7 + 3) % N);
+    IN[I] = static_cast<T>(I*5 + 1);
+  }
+  if (N % 7 == 0) {
+    std::reverse(MAP.begin(),MAP.end());
+  }
+  const std::array<T,N> OUT = uperm::apply_index_map<T,N>(MAP,IN);
+  bool SAME = true;
+  for (size_t I=0; I < MAP.size(); I++) {
+    SAME = SAME && OUT[I] == IN[MAP[I]];
+  }
+  CHECK(SAME);
+}
+
+void check_index_maps() {
+  check_index_map_width<uint8_t,8>();
+  check_index_map_width<uint8_t,12>();
+  check_index_map_width<uint8_t,16>();
+  check_index_map_width<uint8_t,32>();
+  check_index_map_width<uint8_t,64>();
+  check_index_map_width<uint16_t,8>();
+  check_index_map_width<uint16_t,16>();
+  check_index_map_width<uint16_t,32>();
+  check_index_map_width<uint32_t,4>();
+  check_index_map_width<uint32_t,8>();
+  check_index_map_width<uint32_t,16>();
+  //partial registers, masked with AVX-512 BW/VL, movd/movq widths otherwise
+  check_index_map_width<uint8_t,1>();
+  check_index_map_width<uint8_t,3>();
+  check_index_map_width<uint8_t,4>();
+  check_index_map_width<uint8_t,7>();
+  check_index_map_width<uint8_t,20>();
+  check_index_map_width<uint8_t,31>();
+  check_index_map_width<uint16_t,2>();
+  check_index_map_width<uint16_t,4>();
+  check_index_map_width<uint16_t,7>();
+  check_index_map_width<uint16_t,12>();
+  check_index_map_width<uint32_t,1>();
+  check_index_map_width<uint32_t,2>();
+  check_index_map_width<uint32_t,3>();
+  check_index_map_width<uint32_t,6>();
+  check_index_map_width<float,8>();
+  check_index_map_width<double,8>();
+
+  const uperm::index_map<4> MAP = {{3,1,0,2}};
+  const std::array<std::string,4> WORDS = {{"a","b","c","d"}};
+  const std::array<std::string,4> OUT = uperm::apply_index_map<std::string,4>(MAP,WORDS);
+  CHECK(OUT[0] == "d" && OUT[2] == "a");
+}
+
+void check_queue() {
+  uperm::bounded_mpmc_queue<size_t> QUEUE(8);
+  const size_t PER_PRODUCER = 20000;
+  std::atomic<size_t> SUM(0);
+  std::vector<std::thread> THREADS;
+  for (size_t P=0; P < 2; P++) {
+    THREADS.emplace_back([&QUEUE,P,PER_PRODUCER]() {
+      for (size_t I=0; I < PER_PRODUCER; I++) {
+        QUEUE.push(P*PER_PRODUCER + I + 1);
+      }
+    });
+  }
+  for (size_t C=0; C < 2; C++) {
+    THREADS.emplace_back([&QUEUE,&SUM,PER_PRODUCER]() {
+      for (size_t I=0; I < PER_PRODUCER; I++) {
+        size_t V = 0;
+        QUEUE.pop(V);
+        SUM += V;
+      }
+    });
+  }
+  for (auto& thread : THREADS) {
+    thread.join();
+  }
+  const size_t TOTAL = 2*PER_PRODUCER;
+  CHECK(SUM.load() == TOTAL*(TOTAL + 1)/2);
+
+  std::vector<std::atomic<int>> HITS(1000);
+  for (auto& hit : HITS) {
+    hit.store(0);
+  }
+  uperm::parallel_for_ranks(HITS.size(),[&HITS](const size_t BEGIN, const size_t END) {
+    for (size_t K=BEGIN; K < END; K++) {
+      HITS[K]++;
+    }
+  },4,3);
+  size_t ONCE = 0;
+  for (auto& hit : HITS) {
+    ONCE += (hit.load() == 1) ? 1 : 0;
+  }
+  CHECK(ONCE == HITS.size());
+}
+
+//group restricted and multiset generation, against filtered full permutations
+void check_restricted() {
+  const std::vector<std::vector<size_t>> GROUPS = {{0,2,5},{1,3,4,6}};
+  const size_t N = 7;
+  for (size_t L0=0; L0 < 3; L0++) {
+    for (size_t L1=0; L1 < 4; L1++) {
+      const auto TABLE = uperm::get_group_unique_permutations(GROUPS,{L0,L1});
+      CHECK(TABLE.size() == uperm::num_group_unique_permutations(GROUPS,{L0,L1}));
+
+      std::set<std::vector<size_t>> GOT;
+      for (auto const& PLIST : TABLE) {
+        std::vector<size_t> P(N);
+        for (size_t I=0; I < N; I++) {
+          P[I] = I;
+        }
+        for (auto const& perm : PLIST) {
+          std::swap(P[perm.first],P[perm.second]);
+        }
+        GOT.insert(P);
+      }
+      CHECK(GOT.size() == TABLE.size());
+
+      //permutations keeping each group, with (size - cycles) = level per group
+      std::set<std::vector<size_t>> WANT;
+      std::vector<size_t> P(N);
+      for (size_t I=0; I < N; I++) {
+        P[I] = I;
+      }
+      do {
+        bool KEEP = true;
+        const size_t LEVELS[2] = {L0,L1};
+        for (size_t G=0; G < GROUPS.size() && KEEP; G++) {
+          std::vector<bool> IN_GROUP(N,false);
+          for (auto const I : GROUPS[G]) {
+            IN_GROUP[I] = true;
+          }
+          size_t CYCLES = 0;
+          std::vector<bool> SEEN(N,false);
+          for (auto const I : GROUPS[G]) {
+            KEEP = KEEP && IN_GROUP[P[I]];
+            if (!SEEN[I]) {
+              CYCLES++;
+              for (size_t X=I; !SEEN[X] && IN_GROUP[X]; X=P[X]) {
+                SEEN[X] = true;
+              }
+            }
+          }
+          KEEP = KEEP && GROUPS[G].size() - CYCLES == LEVELS[G];
+        }
+        if (KEEP) {
+          WANT.insert(P);
+        }
+      } while (std::next_permutation(P.begin(),P.end()));
+      CHECK(GOT == WANT);
+    }
+  }
+
+  const std::vector<size_t> CLASSES = {0,1,0,2,1,0};
+  std::set<std::vector<size_t>> DISTINCT;
+  size_t EMITTED = 0;
+  for (size_t L=0; L < CLASSES.size(); L++) {
+    const auto TABLE = uperm::get_distinct_unique_permutations(CLASSES,L);
+    CHECK(TABLE.size() == uperm::num_distinct_unique_permutations(CLASSES,L));
+    for (auto const& PLIST : TABLE) {
+      std::vector<size_t> V = CLASSES;
+      uperm::execute_permutations_inplace(PLIST,V);
+      DISTINCT.insert(V);
+      EMITTED++;
+    }
+  }
+  std::vector<size_t> SORTED = CLASSES;
+  std::sort(SORTED.begin(),SORTED.end());
+  size_t WANT = 0;
+  do {
+    WANT++;
+  } while (std::next_permutation(SORTED.begin(),SORTED.end()));
+  CHECK(EMITTED == WANT && DISTINCT.size() == WANT);
+
+  //labels are only compared, sparse ids give the same lists as their dense renumbering
+  const std::vector<size_t> SPARSE = {7,7,9};
+  const std::vector<size_t> DENSE = {0,0,1};
+  for (size_t L=0; L < SPARSE.size(); L++) {
+    const auto GOT = uperm::get_distinct_unique_permutations(SPARSE,L);
+    CHECK(GOT.size() == uperm::num_distinct_unique_permutations(DENSE,L) &&
+          GOT.size() == uperm::num_distinct_unique_permutations(SPARSE,L) &&
+          same_lists(GOT,uperm::get_distinct_unique_permutations(DENSE,L)));
+  }
+  CHECK(uperm::num_distinct_unique_permutations({1000,5,1000,5},2) ==
+        uperm::num_distinct_unique_permutations({1,0,1,0},2));
+}
+
+void check_mmap() {
+#ifdef UPERM_HAVE_MMAP
+  const char* PATH = "uperm_test_table.uperm";
+  auto TABLE = uperm::get_all_unique_permutations<7,3,uint8_t>();
+  CHECK(uperm::write_permutation_table<7>(PATH,TABLE));
+
+  uperm::mapped_permutation_table<7,3,uint8_t> MAPPED;
+  CHECK(MAPPED.open(PATH));
+  CHECK(MAPPED.size() == TABLE.size() && same_lists(TABLE,MAPPED));
+  uperm::mapped_permutation_table<7,3,uint8_t> MOVED(std::move(MAPPED));
+  CHECK(MOVED.is_open() && !MAPPED.is_open());
+
+  //a different shape, and a truncated file, are refused
+  uperm::mapped_permutation_table<8,3,uint8_t> WRONG_N;
+  CHECK(!WRONG_N.open(PATH));
+  uperm::mapped_permutation_table<7,3,uint16_t> WRONG_IDX;
+  CHECK(!WRONG_IDX.open(PATH));
+  MOVED.close();
+  FILE* F = fopen(PATH,"r+b");
+  CHECK(F != NULL);
+  if (F != NULL) {
+    CHECK(ftruncate(fileno(F),128) == 0);
+    fclose(F);
+  }
+  CHECK(!MAPPED.open(PATH));
+
+  //partial tables are not written
+  TABLE.pop_back();
+  CHECK(!uperm::write_permutation_table<7>(PATH,TABLE));
+  remove(PATH);
+#endif
+}
+
+//tensor kernels against index by index references
+template<int N>
+void check_antisymmetrize(const size_t D, const size_t TILE) {
+  size_t S = 1;
+  for (int K=0; K < N; K++) {
+    S *= D;
+  }
+  std::vector<double> IN(S);
+  for (size_t I=0; I < S; I++) {
+    IN[I] = static_cast<double>((I * 37) % 11) - 5.0;
+  }
+  std::vector<double> OUT(S,1.0);
+  std::vector<double> REF(S,1.0);
+  uperm::antisymmetrize_accumulate<N>(IN.data(),OUT.data(),D,0.5,TILE);
+
+  std::array<size_t,N> P;
+  for (size_t K=0; K < P.size(); K++) {
+    P[K] = K;
+  }
+  do {
+    size_t INVERSIONS = 0;
+    for (size_t A=0; A < P.size(); A++) {
+      for (size_t B=A+1; B < P.size(); B++) {
+        INVERSIONS += (P[A] > P[B]) ? 1 : 0;
+      }
+    }
+    const double SIGN = (INVERSIONS % 2) ? -0.5 : 0.5;
+    for (size_t O=0; O < S; O++) {
+      std::array<size_t,N> I;
+      size_t REST = O;
+      for (size_t K=N; K > 0; K--) {
+        I[K-1] = REST % D;
+        REST /= D;
+      }
+      std::array<size_t,N> J;
+      for (size_t K=0; K < P.size(); K++) {
+        J[P[K]] = I[K];
+      }
+      size_t SRC = 0;
+      for (size_t K=0; K < J.size(); K++) {
+        SRC = SRC*D + J[K];
+      }
+      REF[O] += SIGN * IN[SRC];
+    }
+  } while (std::next_permutation(P.begin(),P.end()));
+
+  bool SAME = true;
+  for (size_t O=0; O < S; O++) {
+    SAME = SAME && std::abs(OUT[O] - REF[O]) < 1e-9;
+  }
+  CHECK(SAME);
+}
+
+template<int N>
+void check_transpose(const std::array<size_t,N>& EXTENTS) {
+  size_t S = 1;
+  for (auto const E : EXTENTS) {
+    S *= E;
+  }
+  std::vector<int> IN(S);
+  for (size_t I=0; I < S; I++) {
+    IN[I] = static_cast<int>(I);
+  }
+  const auto IN_STRIDES = uperm::dense_strides<N>(EXTENTS);
+  for (size_t L=0; L < static_cast<size_t>(N); L++) {
+    for (auto const& PLIST : uperm::get_all_unique_permutations<size_t>(N,L)) {
+      const auto MAP = uperm::compose_axis_map<N>(PLIST);
+      std::array<size_t,N> OUT_EXTENTS;
+      for (size_t K=0; K < MAP.size(); K++) {
+        OUT_EXTENTS[K] = EXTENTS[MAP[K]];
+      }
+      std::vector<int> OUT(S,-1);
+      uperm::transpose_axes<N>(PLIST,IN.data(),EXTENTS,OUT.data());
+
+      bool SAME = true;
+      for (size_t O=0; O < S; O++) {
+        size_t REST = O;
+        size_t SRC = 0;
+        for (size_t K=N; K > 0; K--) {
+          SRC += (REST % OUT_EXTENTS[K-1]) * IN_STRIDES[MAP[K-1]];
+          REST /= OUT_EXTENTS[K-1];
+        }
+        SAME = SAME && OUT[O] == IN[SRC];
+      }
+      CHECK(SAME);
+    }
+  }
+}
+
+void check_tensor() {
+  check_antisymmetrize<1>(5,0);
+  check_antisymmetrize<2>(9,2);
+  check_antisymmetrize<3>(7,0);
+  check_antisymmetrize<3>(10,3);
+  check_antisymmetrize<4>(5,2);
+  check_antisymmetrize<4>(6,0);
+  check_transpose<3>({{3,40,5}});
+  check_transpose<4>({{2,3,35,4}});
+}
+
+//the counters of one (N,L), all zero when nothing was recorded
+uperm::permutation_stats stats_of(const size_t N, const size_t L) {
+  uperm::permutation_stats OUT = {N, L, 0, 0, 0, 0, 0};
+  uperm::for_each_permutation_stats([&OUT](const uperm::permutation_stats& S) {
+    if (S.N == OUT.N && S.L == OUT.L) {
+      OUT = S;
+    }
+  });
+  return OUT;
+}
+
+//every apply engine records its swaps and copies under the (N,L) of its table
+void check_stats() {
+  constexpr int N = 5;
+  constexpr int L = 3;
+  const size_t COUNT = uperm::num_unique_permutations(N,L);
+  const auto TABLE = uperm::get_all_unique_permutations<N,L>();
+  std::array<int,N> IN = iota_array<N>();
+  const auto ONLY_AT = [](const size_t SWAPS, const size_t COPIES) {
+    const uperm::permutation_stats S = stats_of(N,L);
+    bool ELSEWHERE = false;
+    uperm::for_each_permutation_stats([&ELSEWHERE](const uperm::permutation_stats& OTHER) {
+      ELSEWHERE = ELSEWHERE || OTHER.N != N || OTHER.L != L;
+    });
+    return !ELSEWHERE && S.SWAPS == SWAPS && S.COPIES == COPIES;
+  };
+
+  uperm::reset_permutation_stats();
+  for (auto const& PLIST : TABLE) {
+    uperm::execute_permutations<std::array<int,N>,L>(PLIST,IN);
+  }
+  CHECK(ONLY_AT(COUNT*L,COUNT));
+
+  //the tree walk swaps down and back up each node, the same at runtime N
+  size_t NODES = 0;
+  for (size_t K=0; K < COUNT; K++) {
+    NODES += (K == 0) ? L : L - static_cast<size_t>(std::find_if(TABLE[K].begin(),TABLE[K].end(),
+      [&](const uperm::index_permutation& P) {
+        const uperm::index_permutation& Q = TABLE[K-1][&P - TABLE[K].data()];
+        return P.first != Q.first || P.second != Q.second;
+      }) - TABLE[K].begin());
+  }
+  uperm::reset_permutation_stats();
+  uperm::apply_all_permutations<N,L>(IN,[](const std::array<int,N>&, const uperm::index_permutation_list<L>&) {});
+  CHECK(ONLY_AT(2*NODES,0));
+  uperm::reset_permutation_stats();
+  std::vector<int> VIN(IN.begin(),IN.end());
+  uperm::apply_all_permutations(N,L,VIN,[](const std::vector<int>&, const uperm::index_permutation_span<size_t>&) {});
+  CHECK(ONLY_AT(2*NODES,0));
+  const size_t LARGE = UPERM_DISPATCH_MAX_N + 2;
+  std::vector<int> LARGE_IN(LARGE,0);
+  uperm::reset_permutation_stats();
+  uperm::apply_all_permutations(LARGE,1,LARGE_IN,[](const std::vector<int>&, const uperm::index_permutation_span<size_t>&) {});
+  CHECK(LARGE >= UPERM_STATS_MAX_N || stats_of(LARGE,1).SWAPS == LARGE*(LARGE - 1));
+
+  //deltas and prefix cache suffixes are partial lists of the level L table
+  uperm::reset_permutation_stats();
+  size_t DELTAS = 0;
+  for (auto const& CURSOR : uperm::minimal_change_permutation_range<N,L>()) {
+    uperm::execute_permutations_inplace(CURSOR.delta(),IN);
+    DELTAS += CURSOR.delta().size();
+  }
+  CHECK(ONLY_AT(DELTAS,0));
+  IN = iota_array<N>();
+
+  uperm::permutation_prefix_cache<std::array<int,N>> CACHE(TABLE,1 << 20);
+  uperm::reset_permutation_stats();
+  CACHE.set_input(IN);
+  const size_t SLOTS = CACHE.num_slots();
+  CHECK(ONLY_AT(SLOTS*CACHE.depth(),SLOTS));
+  uperm::reset_permutation_stats();
+  for (size_t K=0; K < COUNT; K++) {
+    CACHE.execute(K);
+  }
+  CHECK(ONLY_AT(COUNT*(L - CACHE.depth()),COUNT));
+
+  //cycle form, batched, index map, work stealing and static applies
+  const auto CYCLES = uperm::get_all_unique_permutation_cycles<N,L>();
+  uperm::reset_permutation_stats();
+  for (auto const& C : CYCLES) {
+    uperm::execute_permutations_inplace(C,IN);
+    uperm::undo_permutations_inplace(C,IN);
+  }
+  CHECK(ONLY_AT(2*COUNT*L,0));
+
+  const size_t B = 3;
+  std::vector<int> BATCH_IN(N*B,1);
+  std::vector<int> BATCH_OUT(COUNT*N*B);
+  uperm::reset_permutation_stats();
+  uperm::execute_all_permutations_batched<N>(TABLE,BATCH_IN.data(),BATCH_OUT.data(),B);
+  CHECK(ONLY_AT(COUNT*L,COUNT*B));
+
+  const auto MAPS = uperm::get_all_unique_index_maps<N,L>();
+  uperm::reset_permutation_stats();
+  for (auto const& MAP : MAPS) {
+    uperm::apply_index_map<int,N>(MAP,IN);
+  }
+  CHECK(ONLY_AT(0,COUNT));
+
+  std::vector<std::array<int,N>> OUT(COUNT);
+  uperm::reset_permutation_stats();
+  uperm::parallel_execute_permutations(TABLE,IN,OUT,2,1);
+  CHECK(ONLY_AT(COUNT*L,COUNT));
+
+#if __cplusplus >= 201703L
+  uperm::reset_permutation_stats();
+  uperm::apply_all_permutations_static<N,L>(IN,[](const std::array<int,N>&, const uperm::index_permutation_list<L>&) {});
+  CHECK(ONLY_AT(0,COUNT));
+#endif
+  uperm::reset_permutation_stats();
+}
+
+} //end of anonymous namespace
+
+int main() {
+  check_all_levels(std::make_index_sequence<7>());
+  check_runtime();
+  check_parallel();
+  check_index_maps();
+  check_queue();
+  check_restricted();
+  check_mmap();
+  check_tensor();
+  check_stats();
+
+  if (FAILURES > 0) {
+    printf("%zu checks failed\n",FAILURES);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -73,79 +73,221 @@
   
 */
 
+#ifndef UPERM_H
+#define UPERM_H
+
 #include <stdio.h>
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <atomic>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+#ifdef UPERM_ENABLE_STATS
+#include <chrono>
+#endif
+#ifdef UPERM_ENABLE_MPI
+#include <mpi.h>
+#endif
+
+#include "uperm_core.h"
+
+#if defined(__SSSE3__) || defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace uperm {
 
-//contains the indices to permute, starting from zero
-struct index_permutation {
-  size_t first;
-  size_t second;
-  
-};
+/*
+  Opt-in instrumentation
 
-//alias for array of indices to permute
-template<int L> //L is level or # of permutations
-using index_permutation_list = std::array<index_permutation,L>;
+  Compiled with -DUPERM_ENABLE_STATS, the hot paths record per (N,L)
+    SWAPS        swaps executed by every apply engine (execute_permutations,
+                 the in place, tree walk, cycle form, batched and prefix 
+                 cache applies), a cycle of m moves counting as m-1 swaps
+    COPIES       copies of T made by the apply engines
+    BYTES        bytes allocated by the get_all_unique_permutations family
+    GENERATIONS  number of tables generated
+    NANOSECONDS  wall time spent generating them
+  in relaxed atomic counters. Without it the UPERM_STATS_* macros expand
+  to nothing. N and L at or above UPERM_STATS_MAX_N are not recorded.
+  Partial lists (minimal change deltas, prefix cache prefixes and 
+  suffixes) are recorded under the (N,L) of the table they come from.
 
+    uperm::for_each_permutation_stats([](const uperm::permutation_stats& S) {...});
+    uperm::write_permutation_stats_json(stdout);
+*/
+#ifdef UPERM_ENABLE_STATS
 
-//Number of pairs for a given total elements (N) and minimum 
-// LHS index MIN
-constexpr size_t num_unique_pairs_ge_min(const size_t N, 
-                                  const size_t MIN) {
-  return (N-MIN > 0 && MIN <= N-2) ? (N-MIN)*(N-MIN-1)/2 : 0;
-}
+#ifndef UPERM_STATS_MAX_N
+#define UPERM_STATS_MAX_N 32
+#endif
 
-//Number of pairs for a given total elements (N) 
-constexpr size_t num_unique_pairs(const size_t N) {
-  return ( N > 0 ) ? (N)*(N-1)/2 : 0;
+//a snapshot of the counters of one (N,L)
+struct permutation_stats {
+  size_t N;
+  size_t L;
+  uint64_t SWAPS;
+  uint64_t COPIES;
+  uint64_t BYTES;
+  uint64_t GENERATIONS;
+  uint64_t NANOSECONDS;
+};
+
+struct permutation_stats_counters {
+  std::atomic<uint64_t> SWAPS;
+  std::atomic<uint64_t> COPIES;
+  std::atomic<uint64_t> BYTES;
+  std::atomic<uint64_t> GENERATIONS;
+  std::atomic<uint64_t> NANOSECONDS;
+};
+
+//the process wide counters, zero initialized
+inline permutation_stats_counters* permutation_stats_registry() {
+  static permutation_stats_counters COUNTERS[UPERM_STATS_MAX_N][UPERM_STATS_MAX_N];
+  return &COUNTERS[0][0];
 }
 
-//Number of pairs (N) with maximum LHS index (MAX)
-constexpr size_t num_unique_pairs_lt_max(const size_t N,
-                                          const size_t MAX) {
-  return ( N > 0 && MAX >= 0) ? (2*N*MAX - MAX*MAX - MAX)/2 : 0; 
+inline void add_permutation_stats(std::atomic<uint64_t> permutation_stats_counters::* FIELD,
+                                  const size_t N, const size_t L, const uint64_t V) {
+  if (N < UPERM_STATS_MAX_N && L < UPERM_STATS_MAX_N) {
+    (permutation_stats_registry()[N*UPERM_STATS_MAX_N + L].*FIELD).fetch_add(V,std::memory_order_relaxed);
+  }
 }
 
-/*Number of unique permutations of N elements generated from 
-    level L, with LHS index >= MIN */
-constexpr size_t num_unique_permutations_ge_min(const size_t N,
-                                                const size_t L,
-                                                const size_t MIN) {
-  if (L==0) {
-    return 1;
-  } else if ( L < 0 || MIN > N-2) {
+//swaps done by the apply_all_permutations tree walk, two per node below the root
+inline uint64_t tree_walk_swaps(const size_t N, const size_t L) {
+  if (N >= UPERM_STATS_MAX_N || L >= N) {
     return 0;
   }
+  //AT[MIN] = number of depth X nodes whose children start at LHS index MIN
+  uint64_t AT[UPERM_STATS_MAX_N + 1] = {1};
+  uint64_t NODES = 0;
+  for (size_t X=0; X < L; X++) {
+    uint64_t NEXT[UPERM_STATS_MAX_N + 1] = {0};
+    for (size_t MIN=0; MIN < N; MIN++) {
+      for (size_t I=MIN; AT[MIN] && I < N - L + X; I++) {
+        NEXT[I+1] += AT[MIN] * (N - 1 - I);
+        NODES += AT[MIN] * (N - 1 - I);
+      }
+    }
+    std::copy(NEXT,NEXT + N + 1,AT);
+  }
+  return 2*NODES;
+}
 
-  size_t total = 0;
-  for (size_t I=MIN+1; I <= N-2 ; I++) {
-    total += (N-I - 1) * num_unique_permutations_ge_min(N,L-1,I);
+//level of a destination map, N minus its number of cycles
+template<typename Map>
+size_t index_map_level(const Map& MAP) {
+  std::vector<bool> SEEN(MAP.size(),false);
+  size_t CYCLES = 0;
+  for (size_t I=0; I < MAP.size(); I++) {
+    if (!SEEN[I]) {
+      CYCLES++;
+      for (size_t X=I; !SEEN[X]; X=MAP[X]) {
+        SEEN[X] = true;
+      }
+    }
   }
-  return total; 
+  return MAP.size() - CYCLES;
 }
 
+//records one generation of (N,L) and its wall time, from construction to destruction
+class permutation_stats_timer {
+public:
+  permutation_stats_timer(const size_t N, const size_t L) 
+    : N(N), L(L), START(std::chrono::steady_clock::now()) {}
+  ~permutation_stats_timer() {
+    const auto NS = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - START).count();
+    add_permutation_stats(&permutation_stats_counters::GENERATIONS,N,L,1);
+    add_permutation_stats(&permutation_stats_counters::NANOSECONDS,N,L,static_cast<uint64_t>(NS));
+  }
+  permutation_stats_timer(const permutation_stats_timer&) = delete;
+  permutation_stats_timer& operator=(const permutation_stats_timer&) = delete;
 
-/* Number of unique permutations of N elements generated from 
- level L (number of allowed pair swaps) */ 
-constexpr size_t num_unique_permutations(const size_t N, 
-                                         const size_t L) {
+private:
+  size_t N;
+  size_t L;
+  std::chrono::steady_clock::time_point START;
+};
 
-  if (L == 0) {
-    return 1;
-  } else if (L > N - 1) {
-    return 0; 
+//calls VISIT(const permutation_stats&) for every (N,L) with a non zero counter
+template<typename Visitor>
+void for_each_permutation_stats(Visitor&& VISIT) {
+  const permutation_stats_counters* COUNTERS = permutation_stats_registry();
+  for (size_t N=0; N < UPERM_STATS_MAX_N; N++) {
+    for (size_t L=0; L < UPERM_STATS_MAX_N; L++) {
+      const permutation_stats_counters& C = COUNTERS[N*UPERM_STATS_MAX_N + L];
+      const permutation_stats S = {N, L,
+        C.SWAPS.load(std::memory_order_relaxed),
+        C.COPIES.load(std::memory_order_relaxed),
+        C.BYTES.load(std::memory_order_relaxed),
+        C.GENERATIONS.load(std::memory_order_relaxed),
+        C.NANOSECONDS.load(std::memory_order_relaxed)};
+      if (S.SWAPS || S.COPIES || S.BYTES || S.GENERATIONS || S.NANOSECONDS) {
+        VISIT(S);
+      }
+    }
   }
+}
 
-  size_t total = 0;
-  for (size_t I=0; I <= N-2; I++) {
-    total += (N - I - 1) * num_unique_permutations_ge_min(N,L-1,I);
+inline void reset_permutation_stats() {
+  permutation_stats_counters* COUNTERS = permutation_stats_registry();
+  for (size_t K=0; K < UPERM_STATS_MAX_N*UPERM_STATS_MAX_N; K++) {
+    COUNTERS[K].SWAPS.store(0,std::memory_order_relaxed);
+    COUNTERS[K].COPIES.store(0,std::memory_order_relaxed);
+    COUNTERS[K].BYTES.store(0,std::memory_order_relaxed);
+    COUNTERS[K].GENERATIONS.store(0,std::memory_order_relaxed);
+    COUNTERS[K].NANOSECONDS.store(0,std::memory_order_relaxed);
   }
-  return total;
-} 
+}
+
+//writes the non zero counters as a JSON array of objects
+inline void write_permutation_stats_json(FILE* OUT) {
+  bool FIRST = true;
+  fprintf(OUT,"[");
+  for_each_permutation_stats([OUT,&FIRST](const permutation_stats& S) {
+    fprintf(OUT,"%s\n  {\"N\": %zu, \"L\": %zu, \"swaps\": %llu, \"copies\": %llu, "
+                "\"bytes\": %llu, \"generations\": %llu, \"nanoseconds\": %llu}",
+            FIRST ? "" : ",", S.N, S.L,
+            static_cast<unsigned long long>(S.SWAPS),
+            static_cast<unsigned long long>(S.COPIES),
+            static_cast<unsigned long long>(S.BYTES),
+            static_cast<unsigned long long>(S.GENERATIONS),
+            static_cast<unsigned long long>(S.NANOSECONDS));
+    FIRST = false;
+  });
+  fprintf(OUT,"\n]\n");
+}
+
+#define UPERM_STATS_ADD(FIELD,N,L,V) \
+  uperm::add_permutation_stats(&uperm::permutation_stats_counters::FIELD,(N),(L),(V))
+#define UPERM_STATS_TIMER(N,L) \
+  uperm::permutation_stats_timer UPERM_STATS_TIMER_OBJECT((N),(L))
+
+#else
+
+#define UPERM_STATS_ADD(FIELD,N,L,V) ((void)0)
+#define UPERM_STATS_TIMER(N,L) ((void)0)
+
+#endif //UPERM_ENABLE_STATS
 
 
 /*For a given class, execute a permutation list of length L
@@ -157,10 +299,15 @@ constexpr size_t num_unique_permutations(const size_t N,
 	Could reuse intermediate permutations when evaluating a 
 	list of permutations to improve permorfmance.
 	ex: P(1,2) P(0,1) and P(1,3) P(0,1) can reuse the 
-	    P(0,1) result (however this requires copying)*/ 
-template<class T, int L>
-T execute_permutations(const index_permutation_list<L>& PLIST,
+	    P(0,1) result (however this requires copying)
+	    apply_all_permutations does this for a whole level without
+	    the copies, by swapping and unswapping one working copy,
+	    and permutation_prefix_cache keeps such results across inputs*/ 
+template<class T, int L, typename IDX = size_t>
+T execute_permutations(const index_permutation_list<L,IDX>& PLIST,
                        const T& IN) { 
+  UPERM_STATS_ADD(COPIES,IN.size(),L,1);
+  UPERM_STATS_ADD(SWAPS,IN.size(),L,L);
   T OUT = IN;
   for (auto const& perm : PLIST) {
     std::iter_swap(OUT.begin()+perm.first,OUT.begin()+perm.second);
@@ -176,9 +323,12 @@ T execute_permutations(const index_permutation_list<L>& PLIST,
   X is index we are working on 
   MIN is minimum index
   LIST is the index permutation list
+
+  get_all_unique_permutations now uses the compile-time unrolled 
+  unique_permutation_loop below, which emits the same sequence
 */
-template<int N, int LMAX, typename Iterator>
-void inner_permutation_loop(const int L, const int X, const int MIN, index_permutation_list<LMAX>& TMP, 
+template<int N, int LMAX, typename Iterator, typename IDX = size_t>
+void inner_permutation_loop(const int L, const int X, const int MIN, index_permutation_list<LMAX,IDX>& TMP, 
   Iterator& LIST_ELEMENT) {
   if (X > LMAX-1 || L < 0) {
     std::copy(TMP.begin(),TMP.end(),(*LIST_ELEMENT).begin());
@@ -188,8 +338,8 @@ void inner_permutation_loop(const int L, const int X, const int MIN, index_permu
 
   for (size_t I=MIN;I < std::min(N - L,N - 1) ; I++) {
     for (size_t J=I+1; J < N ; J++) {
-      TMP[X] = {I,J}; 
-      inner_permutation_loop<N,LMAX,Iterator>(L-1,X+1,I+1,TMP,LIST_ELEMENT);
+      TMP[X] = {static_cast<IDX>(I),static_cast<IDX>(J)}; 
+      inner_permutation_loop<N,LMAX,Iterator,IDX>(L-1,X+1,I+1,TMP,LIST_ELEMENT);
     }
   } 
   
@@ -199,56 +349,2485 @@ void inner_permutation_loop(const int L, const int X, const int MIN, index_permu
   returns all permutations of N indices a particular level L as a vector
 */
 
-/*
+template<int N, int L, typename IDX = size_t>
+using index_permutation_list_vector = std::vector<index_permutation_list<L,IDX>>;
+
+//table with the smallest index type for N
 template<int N, int L>
-using index_permutation_list_array = std::array<index_permutation_list<L>,num_unique_permutations(N,L)>;
+using compact_index_permutation_list_vector = index_permutation_list_vector<N,L,compact_index_t<N>>;
 
-template <int N, int L>
-index_permutation_list_array<N,L> get_all_unique_permutations() {
-  index_permutation_list_array<N,L> OUT;
+/*
+  allocator that default-initializes instead of value-initializing, so
+  resizing a vector of lists leaves the storage untouched. The pages
+  are then first touched by whoever fills them, e.g. each worker of
+  get_all_unique_permutations_parallel on its own NUMA node
+*/
+template<typename T>
+struct default_init_allocator : std::allocator<T> {
+  template<typename U>
+  struct rebind {
+    using other = default_init_allocator<U>;
+  };
+
+  default_init_allocator() = default;
+  template<typename U>
+  default_init_allocator(const default_init_allocator<U>&) noexcept {}
+
+  template<typename U>
+  void construct(U* P) noexcept(std::is_nothrow_default_constructible<U>::value) {
+    ::new(static_cast<void*>(P)) U;
+  }
+  template<typename U, typename... Args>
+  void construct(U* P, Args&&... ARGS) {
+    ::new(static_cast<void*>(P)) U(std::forward<Args>(ARGS)...);
+  }
+};
+
+//table whose resize does not write the entries
+template<int N, int L, typename IDX = size_t>
+using uninitialized_index_permutation_list_vector = 
+  std::vector<index_permutation_list<L,IDX>,default_init_allocator<index_permutation_list<L,IDX>>>;
+
+/*
+  depth X of the unrolled generator. The L nested (I,J) loops are 
+  instantiated at compile time, one per depth, with the bounds 
+  I < N-L+X and J < N as constants, so after inlining generation is a 
+  plain loop nest with no call or end test per level
+*/
+template<int N, int L, int X>
+struct unique_permutation_loop {
+  template<typename IDX, typename Iterator>
+  static void run(const size_t MIN, index_permutation_list<L,IDX>& TMP, Iterator& OUT) {
+    for (size_t I=MIN; I < static_cast<size_t>(N - L + X); I++) {
+      for (size_t J=I+1; J < static_cast<size_t>(N); J++) {
+        TMP[X] = {static_cast<IDX>(I),static_cast<IDX>(J)};
+        unique_permutation_loop<N,L,X+1>::run(I+1,TMP,OUT);
+      }
+    }
+  }
+};
+
+//innermost depth, writes one list per J
+template<int N, int L>
+struct unique_permutation_loop<N,L,L> {
+  template<typename IDX, typename Iterator>
+  static void run(const size_t, index_permutation_list<L,IDX>& TMP, Iterator& OUT) {
+    *OUT = TMP;
+    ++OUT;
+  }
+};
 
-  if (L == 0) {
-    OUT[0][0] = {0,0};
+/*
+  writes the num_unique_permutations(N,L) level L lists through OUT, in
+  order, and returns the iterator one past the last one
+*/
+template <int N, int L, typename IDX = size_t, typename Iterator>
+Iterator write_all_unique_permutations(Iterator OUT) {
+  if (L > N - 1 && L > 0) {
     return OUT;
   }
 
-  index_permutation_list<L> TMP;
+  index_permutation_list<L,IDX> TMP{};
+  unique_permutation_loop<N,L,0>::run(0,TMP,OUT);
+  return OUT;
+}
 
-  auto ELEMENT = OUT.begin();
-  for (size_t I=0; I < std::min(N - L,N-1) ; I++) {
-    for (size_t J=I+1; J < N ; J++) {
-      TMP[0] = {I,J}; 
-      inner_permutation_loop<N,L>(L-1,0+1,I+1,TMP,ELEMENT);
+//writes the num_unique_permutations(N,L) level L lists to OUT, in order
+template <int N, int L, typename IDX = size_t>
+void fill_all_unique_permutations(index_permutation_list<L,IDX>* OUT) {
+  write_all_unique_permutations<N,L,IDX>(OUT);
+}
+
+template <int N, int L, typename IDX = size_t>
+index_permutation_list_vector<N,L,IDX> get_all_unique_permutations() {
+  UPERM_STATS_TIMER(N,L);
+  index_permutation_list_vector<N,L,IDX> OUT(num_unique_permutations(N,L));
+  UPERM_STATS_ADD(BYTES,N,L,OUT.size()*sizeof(index_permutation_list<L,IDX>));
+
+  fill_all_unique_permutations<N,L,IDX>(OUT.data());
+  return OUT;
+}
+
+
+//fixed size forms of the raw pointer first/next_unique_permutation of uperm_core.h
+template<int N, int L, typename IDX>
+UPERM_CONSTEXPR17 void first_unique_permutation(index_permutation_list<L,IDX>& PLIST) {
+  first_unique_permutation(L,PLIST.data());
+}
+
+template<int N, int L, typename IDX>
+UPERM_CONSTEXPR17 bool next_unique_permutation(index_permutation_list<L,IDX>& PLIST) {
+  return next_unique_permutation(N,L,PLIST.data());
+}
+
+#if __cplusplus >= 201703L
+/*
+  Compile-time tables (C++17): for fixed N and L the whole level L 
+  sequence is built as a constant expression, so 
+
+    constexpr auto PERMS = uperm::get_all_unique_permutations_array<N,L>();
+
+  or the unique_permutation_table<N,L> variable below lives in .rodata,
+  with no runtime generation and no heap
+*/
+template<int N, int L, typename IDX = size_t>
+using index_permutation_list_array = std::array<index_permutation_list<L,IDX>,num_unique_permutations(N,L)>;
+
+template <int N, int L, typename IDX = size_t>
+constexpr index_permutation_list_array<N,L,IDX> get_all_unique_permutations_array() {
+  index_permutation_list_array<N,L,IDX> OUT{};
+
+  index_permutation_list<L,IDX> PLIST{};
+  first_unique_permutation<N,L>(PLIST);
+  for (auto& element : OUT) {
+    element = PLIST;
+    next_unique_permutation<N,L>(PLIST);
+  }
+
+  return OUT;
+}
+
+template <int N, int L, typename IDX = size_t>
+inline constexpr index_permutation_list_array<N,L,IDX> unique_permutation_table = 
+  get_all_unique_permutations_array<N,L,IDX>();
+#endif
+
+/*
+  Lazy range over the level L permutation lists of N indices. Visits 
+  the same sequence as get_all_unique_permutations, in the same order,
+  but only stores the current list (O(L) state), so nothing is 
+  allocated up front. The iterator holds that list and *IT refers into
+  it, so it is an input iterator: a reference is only valid until the
+  iterator is advanced; copy the list to keep it.
+
+  for (auto const& perm : uperm::unique_permutation_range<N,L>()) {...}
+*/
+template<int N, int L, typename IDX = size_t>
+class unique_permutation_range {
+  public:
+  class iterator {
+    public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = index_permutation_list<L,IDX>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    iterator() : K(0) {first_unique_permutation<N,L>(PLIST);}
+    explicit iterator(const size_t K0) : K(K0) {first_unique_permutation<N,L>(PLIST);}
+
+    reference operator*() const {return PLIST;}
+    pointer operator->() const {return &PLIST;}
+
+    iterator& operator++() {
+      next_unique_permutation<N,L>(PLIST);
+      K++;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator TMP = *this;
+      ++(*this);
+      return TMP;
     }
+
+    //position of the current list in the sequence
+    size_t index() const {return K;}
+
+    bool operator==(const iterator& OTHER) const {return K == OTHER.K;}
+    bool operator!=(const iterator& OTHER) const {return K != OTHER.K;}
+
+    private:
+    friend class unique_permutation_range;
+    size_t K;
+    index_permutation_list<L,IDX> PLIST;
+  };
+
+  unique_permutation_range() : FIRST(0), COUNT(num_unique_permutations(N,L)) {}
+  //the lists of ranks BEGIN..END-1 only, resuming from the unranked list BEGIN. END is
+  //clamped to the level size
+  unique_permutation_range(const size_t BEGIN, const size_t END) 
+    : FIRST(std::min(BEGIN,END)), COUNT(std::min(END,num_unique_permutations(N,L))) {
+    FIRST = std::min(FIRST,COUNT);
+  }
+
+  iterator begin() const {
+    iterator IT(FIRST);
+    if (FIRST < COUNT) {
+      unrank_unique_permutation(N,L,FIRST,IT.PLIST.data());
+    }
+    return IT;
+  }
+  iterator end() const {return iterator(COUNT);}
+  size_t size() const {return COUNT - FIRST;}
+  bool empty() const {return COUNT == FIRST;}
+
+  private:
+  size_t FIRST;
+  size_t COUNT;  //one past the last rank
+};
+
+
+//fixed size forms of the raw pointer rank/unrank_unique_permutation of uperm_core.h
+template<int N, int L, typename IDX = size_t>
+index_permutation_list<L,IDX> unrank_unique_permutation(size_t K) {
+  assert(K < num_unique_permutations(N,L));
+  index_permutation_list<L,IDX> PLIST{};
+  unrank_unique_permutation(N,L,K,PLIST.data());
+  return PLIST;
+}
+
+template<int N, int L, typename IDX>
+size_t rank_unique_permutation(const index_permutation_list<L,IDX>& PLIST) {
+  return rank_unique_permutation(N,L,PLIST.data());
+}
+
+
+/*
+  writes COUNT consecutive level L lists, starting at position FIRST of
+  the sequence, through the output iterator OUT. Returns the iterator
+  one past the last list written
+*/
+template<int N, int L, typename IDX = size_t, typename Iterator>
+Iterator fill_unique_permutations(const size_t FIRST, const size_t COUNT,
+                                  Iterator OUT) {
+  if (COUNT == 0) {
+    return OUT;
+  }
+
+  index_permutation_list<L,IDX> PLIST = unrank_unique_permutation<N,L,IDX>(FIRST);
+  for (size_t K=0; K < COUNT; K++) {
+    *OUT = PLIST;
+    ++OUT;
+    next_unique_permutation<N,L>(PLIST);
+  }
+  return OUT;
+}
+
+/*
+  fills OUT with all permutations of N indices at level L, using 
+  NTHREADS workers (0 uses std::thread::hardware_concurrency). 
+
+  The output is split into contiguous rank ranges, each worker unranks 
+  the start of its range and writes only its own slice, so the result
+  holds the same lists as get_all_unique_permutations<N,L>(). With an
+  uninitialized_index_permutation_list_vector the storage is resized 
+  without being written, so each worker also takes the first touch of
+  its own pages and nothing runs serially before the workers start.
+*/
+template <int N, int L, typename IDX, typename Allocator>
+void get_all_unique_permutations_parallel(std::vector<index_permutation_list<L,IDX>,Allocator>& OUT,
+                                          unsigned NTHREADS = 0) {
+  //below this many lists per thread, spawning threads costs more than it saves
+  const size_t MIN_PER_THREAD = 4096;
+
+  UPERM_STATS_TIMER(N,L);
+  const size_t COUNT = num_unique_permutations(N,L);
+  UPERM_STATS_ADD(BYTES,N,L,(COUNT > OUT.capacity() ? COUNT - OUT.capacity() : 0)*
+                            sizeof(index_permutation_list<L,IDX>));
+  OUT.resize(COUNT);
+
+  if (NTHREADS == 0) {
+    NTHREADS = std::max(1u,std::thread::hardware_concurrency());
+  }
+  NTHREADS = static_cast<unsigned>(std::min<size_t>(NTHREADS,COUNT/MIN_PER_THREAD));
+  if (L == 0 || NTHREADS <= 1) {
+    fill_all_unique_permutations<N,L,IDX>(OUT.data());
+    return;
+  }
+
+  std::vector<std::thread> WORKERS;
+  WORKERS.reserve(NTHREADS);
+  for (unsigned T=0; T < NTHREADS; T++) {
+    const size_t BEGIN = COUNT * T / NTHREADS;
+    const size_t END = COUNT * (T + 1) / NTHREADS;
+    WORKERS.emplace_back([&OUT,BEGIN,END]() {
+      fill_unique_permutations<N,L,IDX>(BEGIN,END-BEGIN,OUT.begin()+BEGIN);
+    });
+  }
+  for (auto& worker : WORKERS) {
+    worker.join();
   }
+}
 
+//as above into a new table, the same type get_all_unique_permutations<N,L,IDX>() returns
+template <int N, int L, typename IDX = size_t>
+index_permutation_list_vector<N,L,IDX> get_all_unique_permutations_parallel(unsigned NTHREADS = 0) {
+  index_permutation_list_vector<N,L,IDX> OUT;
+  get_all_unique_permutations_parallel<N,L,IDX>(OUT,NTHREADS);
   return OUT;
 }
+
+
+/*
+  Generation into caller supplied memory
+
+  The overloads below fill storage owned by the caller, so generating
+  many (N,L) tables in a loop reuses one buffer instead of allocating a
+  fresh vector each time:
+    - a vector (with any allocator) is resized and refilled, keeping 
+      its capacity, e.g. a std::pmr::vector on a monotonic arena
+    - a raw buffer of CAPACITY lists, snprintf style: the level size is
+      returned and nothing is written if it does not fit
+    - any output iterator, e.g. std::back_inserter
+*/
+template <int N, int L, typename IDX, typename Allocator>
+void get_all_unique_permutations(std::vector<index_permutation_list<L,IDX>,Allocator>& OUT) {
+  UPERM_STATS_TIMER(N,L);
+  const size_t COUNT = num_unique_permutations(N,L);
+  UPERM_STATS_ADD(BYTES,N,L,(COUNT > OUT.capacity() ? COUNT - OUT.capacity() : 0)*
+                            sizeof(index_permutation_list<L,IDX>));
+  OUT.resize(COUNT);
+
+  fill_all_unique_permutations<N,L,IDX>(OUT.data());
+}
+
+template <int N, int L, typename IDX>
+size_t get_all_unique_permutations(index_permutation_list<L,IDX>* OUT, const size_t CAPACITY) {
+  const size_t COUNT = num_unique_permutations(N,L);
+  if (COUNT <= CAPACITY) {
+    UPERM_STATS_TIMER(N,L);
+    fill_all_unique_permutations<N,L,IDX>(OUT);
+  }
+  return COUNT;
+}
+
+//returns the iterator one past the last list written
+template <int N, int L, typename IDX = size_t, typename Iterator>
+Iterator get_all_unique_permutations(Iterator OUT) {
+  UPERM_STATS_TIMER(N,L);
+  return write_all_unique_permutations<N,L,IDX>(OUT);
+}
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+//level table on a polymorphic memory resource, filled by the vector overload above
+template<int N, int L, typename IDX = size_t>
+using pmr_index_permutation_list_vector = std::pmr::vector<index_permutation_list<L,IDX>>;
+#endif
+#endif
+
+
+/*
+  depth X of the apply_all_permutations tree walk. Each node swaps
+  (I,J) into DATA on the way down and swaps it back on the way up, so 
+  the lists sharing a prefix share its swaps
 */
+template<int N, int L, int X>
+struct apply_all_permutations_loop {
+  template<class T, typename Visitor>
+  static void run(const size_t MIN, T& DATA, index_permutation_list<L>& PLIST,
+                  Visitor& VISIT) {
+    for (size_t I=MIN; I < static_cast<size_t>(N - L + X); I++) {
+      for (size_t J=I+1; J < static_cast<size_t>(N); J++) {
+        std::iter_swap(DATA.begin()+I,DATA.begin()+J);
+        PLIST[X] = {I,J};
+        apply_all_permutations_loop<N,L,X+1>::run(I+1,DATA,PLIST,VISIT);
+        std::iter_swap(DATA.begin()+I,DATA.begin()+J);
+      }
+    }
+  }
+};
 
+//leaf of the tree walk, DATA holds execute_permutations(PLIST,IN) 
 template<int N, int L>
-using index_permutation_list_vector = std::vector<index_permutation_list<L>>;
-template <int N, int L>
-index_permutation_list_vector<N,L> get_all_unique_permutations() {
-  index_permutation_list_vector<N,L> OUT(num_unique_permutations(N,L));
+struct apply_all_permutations_loop<N,L,L> {
+  template<class T, typename Visitor>
+  static void run(const size_t, T& DATA, index_permutation_list<L>& PLIST,
+                  Visitor& VISIT) {
+    VISIT(static_cast<const T&>(DATA),
+          static_cast<const index_permutation_list<L>&>(PLIST));
+  }
+};
 
-  if (L == 0) {
-    OUT[0][0] = {0,0};
-    return OUT;
+/*
+  Applies every level L permutation list of N indices to DATA, calling
+  VISIT(PERMUTED, PLIST) for each one, in the order of
+  get_all_unique_permutations. PERMUTED is equal to 
+  execute_permutations(PLIST,DATA).
+
+  The generation tree is walked depth first on DATA itself, which 
+  costs amortized O(1) swaps per list and never copies T. DATA is 
+  restored when the call returns. VISIT must not modify it.
+
+  This requires the class to have a .begin() iterator
+*/
+template<int N, int L, class T, typename Visitor>
+void apply_all_permutations(T& DATA, Visitor&& VISIT) {
+  if (L > N - 1) {
+    return;
+  }
+
+  UPERM_STATS_ADD(SWAPS,N,L,tree_walk_swaps(N,L));
+  index_permutation_list<L> PLIST{};
+  apply_all_permutations_loop<N,L,0>::run(0,DATA,PLIST,VISIT);
+}
+
+
+/*
+  Composed index maps
+
+  Instead of a list of swaps, each level L entry can be stored as the 
+  destination map it composes to:
+
+    execute_permutations(PLIST,IN)[i] == IN[MAP[i]]
+
+  which is applied with a single gather (or byte shuffle) regardless 
+  of L. Indices are stored as uint8_t, so N is limited to 256
+*/
+template<int N>
+using index_map = std::array<uint8_t,N>;
+
+template<int N, int L>
+using index_map_vector = std::vector<index_map<N>>;
+
+//returns the composed index map of PLIST
+template<int N, int L, typename IDX = size_t>
+UPERM_CONSTEXPR17 index_map<N> compose_index_map(const index_permutation_list<L,IDX>& PLIST) {
+  static_assert(N <= 256, "index_map stores indices as uint8_t");
+  index_map<N> MAP{};
+  for (size_t I=0; I < MAP.size(); I++) {
+    MAP[I] = static_cast<uint8_t>(I);
+  }
+  for (auto const& perm : PLIST) {
+    const uint8_t TMP = MAP[perm.first];
+    MAP[perm.first] = MAP[perm.second];
+    MAP[perm.second] = TMP;
   }
+  return MAP;
+}
 
-  index_permutation_list<L> TMP;
+/* 
+  returns the composed index maps of all permutations of N indices at
+  level L, in the order of get_all_unique_permutations
+*/
+template <int N, int L>
+index_map_vector<N,L> get_all_unique_index_maps() {
+  static_assert(N <= 256, "index_map stores indices as uint8_t");
+  UPERM_STATS_TIMER(N,L);
+  index_map_vector<N,L> OUT(num_unique_permutations(N,L));
+  UPERM_STATS_ADD(BYTES,N,L,OUT.size()*sizeof(index_map<N>));
 
+  index_map<N> IDENTITY = compose_index_map<N,0>({});
   auto ELEMENT = OUT.begin();
-  for (size_t I=0; I < std::min(N - L,N-1) ; I++) {
-    for (size_t J=I+1; J < N ; J++) {
-      TMP[0] = {I,J}; 
-      inner_permutation_loop<N,L>(L-1,0+1,I+1,TMP,ELEMENT);
+  apply_all_permutations<N,L>(IDENTITY,
+    [&ELEMENT](const index_map<N>& MAP, const index_permutation_list<L>&) {
+      *ELEMENT = MAP;
+      ++ELEMENT;
+    });
+
+  return OUT;
+}
+
+/*
+  byte shuffle kernels for apply_index_map. Returns false when no 
+  kernel fits T and N on the target, in which case OUT is untouched.
+
+  Arrays that fill a whole register load and store IN, OUT and the N
+  map bytes directly. Shorter arrays must not touch the bytes past 
+  them. With AVX-512 BW/VL they use masked loads, for any N*sizeof(T)
+  up to 32. Without it only 4 and 8 byte arrays (movd/movq)
+  are shuffled: a padded copy of any other width costs more than the
+  scalar gather. The element map is widened to a byte map for 2 and 4
+  byte T (bytes S*MAP[i] .. S*MAP[i]+S-1), then one shuffle moves the
+  whole array:
+    SSSE3    pshufb     N*sizeof(T) == 16, 8 or 4
+    AVX2     vpermd     4 byte T, N == 8
+    AVX-512  vperm{b,w,d} 32 or 64 bytes (VBMI for bytes, BW for words)
+             masked pshufb / vperm{b,w,d} for every other width below 32
+    AArch64  tbl        N*sizeof(T) == 16, 8 or 4
+
+  Only trivially copyable 1, 2 and 4 byte T reach the kernels, any other
+  T gets the overload that always returns false.
+*/
+template<class T>
+using simd_index_map_element = std::integral_constant<bool,std::is_trivially_copyable<T>::value && 
+                                 (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4)>;
+
+template<class T, int N>
+inline typename std::enable_if<!simd_index_map_element<T>::value,bool>::type
+apply_index_map_simd(const index_map<N>&, const std::array<T,N>&, std::array<T,N>&) {
+  return false;
+}
+
+#if defined(__SSSE3__)
+//pshufb control moving S byte elements, from element map bytes in the low lanes of MAP_BYTES
+template<size_t S>
+inline __m128i shuffle_control_epi8(__m128i MAP_BYTES) {
+  if (S == 2) {
+    MAP_BYTES = _mm_unpacklo_epi8(MAP_BYTES,MAP_BYTES);
+    return _mm_add_epi8(_mm_add_epi8(MAP_BYTES,MAP_BYTES),_mm_set1_epi16(0x0100));
+  } else if (S == 4) {
+    MAP_BYTES = _mm_unpacklo_epi8(MAP_BYTES,MAP_BYTES);
+    MAP_BYTES = _mm_unpacklo_epi16(MAP_BYTES,MAP_BYTES);
+    return _mm_add_epi8(_mm_slli_epi32(MAP_BYTES,2),_mm_set1_epi32(0x03020100));
+  }
+  return MAP_BYTES;
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+//tbl control moving S byte elements, from element map bytes in the low lanes of MAP_BYTES
+template<size_t S>
+inline uint8x16_t shuffle_control_u8(uint8x16_t MAP_BYTES) {
+  if (S == 2) {
+    MAP_BYTES = vzip1q_u8(MAP_BYTES,MAP_BYTES);
+    return vaddq_u8(vaddq_u8(MAP_BYTES,MAP_BYTES),vreinterpretq_u8_u16(vdupq_n_u16(0x0100)));
+  } else if (S == 4) {
+    MAP_BYTES = vzip1q_u8(MAP_BYTES,MAP_BYTES);
+    MAP_BYTES = vreinterpretq_u8_u16(vzip1q_u16(vreinterpretq_u16_u8(MAP_BYTES),vreinterpretq_u16_u8(MAP_BYTES)));
+    return vaddq_u8(vshlq_n_u8(MAP_BYTES,2),vreinterpretq_u8_u32(vdupq_n_u32(0x03020100)));
+  }
+  return MAP_BYTES;
+}
+#endif
+
+//GCC 12 flags the _mm*_undefined_* operands inside its own AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+template<class T, int N>
+inline typename std::enable_if<simd_index_map_element<T>::value,bool>::type
+apply_index_map_simd(const index_map<N>& MAP, const std::array<T,N>& IN, std::array<T,N>& OUT) {
+  constexpr size_t S = sizeof(T);
+  constexpr size_t BYTES = S * N;
+
+#if defined(__AVX512VBMI__) && defined(__AVX512VL__)
+  if (S == 1 && BYTES == 32) {
+    const __m256i R = _mm256_permutexvar_epi8(_mm256_loadu_si256((const __m256i*)MAP.data()),
+                                              _mm256_loadu_si256((const __m256i*)IN.data()));
+    _mm256_storeu_si256((__m256i*)OUT.data(),R);
+    return true;
+  }
+#endif
+#if defined(__AVX512VBMI__)
+  if (S == 1 && BYTES == 64) {
+    const __m512i R = _mm512_permutexvar_epi8(_mm512_loadu_si512(MAP.data()),_mm512_loadu_si512(IN.data()));
+    _mm512_storeu_si512(OUT.data(),R);
+    return true;
+  }
+#endif
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+  if (S == 2 && BYTES == 32) {
+    const __m256i WIDE = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)MAP.data()));
+    const __m256i R = _mm256_permutexvar_epi16(WIDE,_mm256_loadu_si256((const __m256i*)IN.data()));
+    _mm256_storeu_si256((__m256i*)OUT.data(),R);
+    return true;
+  }
+#endif
+#if defined(__AVX512BW__)
+  if (S == 2 && BYTES == 64) {
+    const __m512i WIDE = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)MAP.data()));
+    const __m512i R = _mm512_permutexvar_epi16(WIDE,_mm512_loadu_si512(IN.data()));
+    _mm512_storeu_si512(OUT.data(),R);
+    return true;
+  }
+#endif
+#if defined(__AVX2__)
+  if (S == 4 && BYTES == 32) {
+    const __m256i WIDE = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)MAP.data()));
+    const __m256i R = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)IN.data()),WIDE);
+    _mm256_storeu_si256((__m256i*)OUT.data(),R);
+    return true;
+  }
+#endif
+#if defined(__AVX512F__)
+  if (S == 4 && BYTES == 64) {
+    const __m512i WIDE = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)MAP.data()));
+    const __m512i R = _mm512_permutexvar_epi32(WIDE,_mm512_loadu_si512(IN.data()));
+    _mm512_storeu_si512(OUT.data(),R);
+    return true;
+  }
+#endif
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+  /*
+    partial registers: masked loads stay inside MAP and IN. OUT is written
+    from a staged register by plain stores, which later loads of OUT can
+    forward from, unlike a masked store
+  */
+  constexpr uint32_t ARRAY_MASK = (BYTES < 32) ? (1u << (BYTES % 32)) - 1 : ~0u;
+  constexpr uint32_t MAP_MASK = (N < 32) ? (1u << (N % 32)) - 1 : ~0u;
+  if (BYTES < 16) {
+    const __m128i CTRL = shuffle_control_epi8<S>(_mm_maskz_loadu_epi8(static_cast<__mmask16>(MAP_MASK),MAP.data()));
+    const __m128i R = _mm_shuffle_epi8(_mm_maskz_loadu_epi8(static_cast<__mmask16>(ARRAY_MASK),IN.data()),CTRL);
+    alignas(16) uint8_t STAGE[16];
+    _mm_store_si128((__m128i*)STAGE,R);
+    std::memcpy(OUT.data(),STAGE,BYTES);
+    return true;
+  }
+  if (S != 1 && BYTES > 16 && BYTES < 32) {
+    const __m128i NARROW = _mm_maskz_loadu_epi8(static_cast<__mmask16>(MAP_MASK),MAP.data());
+    const __m256i DATA = _mm256_maskz_loadu_epi8(ARRAY_MASK,IN.data());
+    const __m256i R = (S == 2) ? _mm256_permutexvar_epi16(_mm256_cvtepu8_epi16(NARROW),DATA)
+                               : _mm256_permutexvar_epi32(_mm256_cvtepu8_epi32(NARROW),DATA);
+    alignas(32) uint8_t STAGE[32];
+    _mm256_store_si256((__m256i*)STAGE,R);
+    std::memcpy(OUT.data(),STAGE,BYTES);
+    return true;
+  }
+#if defined(__AVX512VBMI__)
+  if (S == 1 && BYTES > 16 && BYTES < 32) {
+    const __m256i R = _mm256_permutexvar_epi8(_mm256_maskz_loadu_epi8(MAP_MASK,MAP.data()),
+                                              _mm256_maskz_loadu_epi8(ARRAY_MASK,IN.data()));
+    alignas(32) uint8_t STAGE[32];
+    _mm256_store_si256((__m256i*)STAGE,R);
+    std::memcpy(OUT.data(),STAGE,BYTES);
+    return true;
+  }
+#endif
+#endif
+#if defined(__SSSE3__)
+  if (BYTES == 16 || BYTES == 8 || BYTES == 4) {
+    //the N map bytes are at most 16, 8 or 4, load exactly those
+    __m128i MAP_BYTES;
+    if (N == 16) {
+      MAP_BYTES = _mm_loadu_si128((const __m128i*)MAP.data());
+    } else if (N == 8) {
+      MAP_BYTES = _mm_loadl_epi64((const __m128i*)MAP.data());
+    } else {
+      uint32_t WORD = 0;
+      std::memcpy(&WORD,MAP.data(),N);
+      MAP_BYTES = _mm_cvtsi32_si128(static_cast<int>(WORD));
+    }
+    const __m128i CTRL = shuffle_control_epi8<S>(MAP_BYTES);
+    if (BYTES == 16) {
+      _mm_storeu_si128((__m128i*)OUT.data(),_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)IN.data()),CTRL));
+    } else if (BYTES == 8) {
+      _mm_storel_epi64((__m128i*)OUT.data(),_mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)IN.data()),CTRL));
+    } else {
+      int32_t WORD;
+      std::memcpy(&WORD,IN.data(),sizeof(WORD));
+      WORD = _mm_cvtsi128_si32(_mm_shuffle_epi8(_mm_cvtsi32_si128(WORD),CTRL));
+      std::memcpy(OUT.data(),&WORD,sizeof(WORD));
     }
+    return true;
   }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  if (BYTES == 16 || BYTES == 8 || BYTES == 4) {
+    uint8x16_t MAP_BYTES = vdupq_n_u8(0);
+    if (N == 16) {
+      MAP_BYTES = vld1q_u8(MAP.data());
+    } else if (N == 8) {
+      MAP_BYTES = vcombine_u8(vld1_u8(MAP.data()),vdup_n_u8(0));
+    } else {
+      uint32_t WORD = 0;
+      std::memcpy(&WORD,MAP.data(),N);
+      MAP_BYTES = vreinterpretq_u8_u32(vsetq_lane_u32(WORD,vdupq_n_u32(0),0));
+    }
+    const uint8x16_t CTRL = shuffle_control_u8<S>(MAP_BYTES);
+    const uint8_t* SRC = reinterpret_cast<const uint8_t*>(IN.data());
+    uint8_t* DST = reinterpret_cast<uint8_t*>(OUT.data());
+    if (BYTES == 16) {
+      vst1q_u8(DST,vqtbl1q_u8(vld1q_u8(SRC),CTRL));
+    } else if (BYTES == 8) {
+      vst1_u8(DST,vget_low_u8(vqtbl1q_u8(vcombine_u8(vld1_u8(SRC),vdup_n_u8(0)),CTRL)));
+    } else {
+      uint32_t WORD;
+      std::memcpy(&WORD,SRC,sizeof(WORD));
+      const uint8x16_t R = vqtbl1q_u8(vreinterpretq_u8_u32(vdupq_n_u32(WORD)),CTRL);
+      WORD = vgetq_lane_u32(vreinterpretq_u32_u8(R),0);
+      std::memcpy(DST,&WORD,sizeof(WORD));
+    }
+    return true;
+  }
+#endif
+
+  (void)MAP; (void)IN; (void)OUT; (void)BYTES;
+  return false;
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
+/*
+  applies a composed index map to IN, returning OUT[i] = IN[MAP[i]].
+  Uses a single shuffle when a kernel fits the array (see 
+  apply_index_map_simd), otherwise a scalar gather
+*/
+template<class T, int N>
+inline std::array<T,N> apply_index_map(const index_map<N>& MAP, const std::array<T,N>& IN) {
+  UPERM_STATS_ADD(COPIES,N,index_map_level(MAP),1);
+  std::array<T,N> OUT;
+  if (!apply_index_map_simd<T,N>(MAP,IN,OUT)) {
+    for (size_t I=0; I < OUT.size(); I++) {
+      OUT[I] = IN[MAP[I]];
+    }
+  }
   return OUT;
 }
 
 
-} //end of namespace
+/*
+  Non-owning view of one permutation list whose length is only known
+  at runtime, such as the entries of index_permutation_levels
+*/
+template<typename IDX = size_t>
+struct index_permutation_span {
+  const basic_index_permutation<IDX>* DATA;
+  size_t SIZE;
+  size_t LEVEL = 0;  //level of the table a partial list comes from, 0 when it is SIZE
+
+  const basic_index_permutation<IDX>* begin() const {return DATA;}
+  const basic_index_permutation<IDX>* end() const {return DATA + SIZE;}
+  size_t size() const {return SIZE;}
+  size_t level() const {return LEVEL ? LEVEL : SIZE;}
+  const basic_index_permutation<IDX>& operator[](const size_t X) const {return DATA[X];}
+};
+
+//execute_permutations for a runtime length list
+template<class T, typename IDX>
+T execute_permutations(const index_permutation_span<IDX>& PLIST, const T& IN) {
+  UPERM_STATS_ADD(COPIES,IN.size(),PLIST.level(),1);
+  UPERM_STATS_ADD(SWAPS,IN.size(),PLIST.level(),PLIST.size());
+  T OUT = IN;
+  for (auto const& perm : PLIST) {
+    std::iter_swap(OUT.begin()+perm.first,OUT.begin()+perm.second);
+  }
+  return OUT;
+}
+
+/*
+  writes all num_unique_permutations(N,L) level L lists back to back 
+  at OUT, each list is generated in place from a copy of the previous 
+  one
+*/
+template<typename IDX>
+void fill_unique_permutations(const int N, const int L, basic_index_permutation<IDX>* OUT) {
+  const size_t COUNT = num_unique_permutations(N,L);
+  if (L == 0 || COUNT == 0) {
+    return;
+  }
+
+  first_unique_permutation(L,OUT);
+  for (size_t K=1; K < COUNT; K++) {
+    std::copy(OUT,OUT+L,OUT+L);
+    OUT += L;
+    next_unique_permutation(N,L,OUT);
+  }
+}
+
+/*
+  The lists of one level stored back to back in a flat buffer, L swaps
+  per list. Iterating yields an index_permutation_span per list, by 
+  value, so the iterator is an input iterator
+*/
+template<typename IDX = size_t>
+class index_permutation_level_view {
+  public:
+  class iterator {
+    public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = index_permutation_span<IDX>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = value_type;
+
+    iterator(const basic_index_permutation<IDX>* P, const size_t STRIDE, const size_t K) 
+      : P(P), STRIDE(STRIDE), K(K) {}
+
+    value_type operator*() const {return {P,STRIDE};}
+    iterator& operator++() {P += STRIDE; K++; return *this;}
+    iterator operator++(int) {iterator TMP = *this; ++(*this); return TMP;}
+    bool operator==(const iterator& OTHER) const {return K == OTHER.K;}
+    bool operator!=(const iterator& OTHER) const {return K != OTHER.K;}
+
+    private:
+    const basic_index_permutation<IDX>* P;
+    size_t STRIDE;
+    size_t K;
+  };
+
+  index_permutation_level_view(const basic_index_permutation<IDX>* DATA, const size_t L, const size_t COUNT) 
+    : DATA(DATA), L(L), COUNT(COUNT) {}
+
+  index_permutation_span<IDX> operator[](const size_t K) const {return {DATA + K*L,L};}
+  iterator begin() const {return iterator(DATA,L,0);}
+  iterator end() const {return iterator(DATA + COUNT*L,L,COUNT);}
+  size_t size() const {return COUNT;}
+  size_t level() const {return L;}
+
+  private:
+  const basic_index_permutation<IDX>* DATA;
+  size_t L;
+  size_t COUNT;
+};
+
+/*
+  All levels 0..N-1 of the permutation lists of N indices, stored back
+  to back (CSR style) in a single buffer:
+
+    level L holds num_unique_permutations(N,L) lists of L swaps each,
+    starting at swap OFFSETS[L] of the buffer
+
+  so the b_0..b_{N-1} construction described at the top of this file
+  is one allocation and one sequential pass
+*/
+template<int N, typename IDX = size_t>
+class index_permutation_levels {
+  public:
+
+  using level_view = index_permutation_level_view<IDX>;
+
+  index_permutation_levels() {
+    OFFSETS[0] = 0;
+    for (int L=0; L < N; L++) {
+      OFFSETS[L+1] = OFFSETS[L] + L * num_unique_permutations(N,L);
+    }
+    SWAPS.resize(OFFSETS[N]);
+
+    for (int L=1; L < N; L++) {
+      fill_unique_permutations(N,L,SWAPS.data() + OFFSETS[L]);
+    }
+  }
+
+  level_view level(const size_t L) const {
+    return level_view(SWAPS.data() + OFFSETS[L],L,num_unique_permutations(N,L));
+  }
+  size_t num_levels() const {return N;}
+
+  //all swaps of all levels, and where each level starts in them
+  const std::vector<basic_index_permutation<IDX>>& swaps() const {return SWAPS;}
+  const std::array<size_t,N+1>& offsets() const {return OFFSETS;}
+
+  private:
+  std::vector<basic_index_permutation<IDX>> SWAPS;
+  std::array<size_t,N+1> OFFSETS;
+};
+
+//returns every level of the permutation lists of N indices in one buffer
+template<int N, typename IDX = size_t>
+index_permutation_levels<N,IDX> get_all_unique_permutation_levels() {
+  return index_permutation_levels<N,IDX>();
+}
+
+
+/*
+  Runtime N and L
+
+  For problem sizes that are only known at runtime, the level L lists 
+  are stored flat with a runtime stride in an index_permutation_table.
+  For N <= UPERM_DISPATCH_MAX_N the work is dispatched through a table
+  of the compile-time specialized paths (one instantiation per (N,L) 
+  pair, made here once), larger N use the generic runtime loops
+*/
+#ifndef UPERM_DISPATCH_MAX_N
+#define UPERM_DISPATCH_MAX_N 8
+#endif
+
+//owning table of the level L lists of N indices, N and L set at runtime
+template<typename IDX = size_t>
+class index_permutation_table {
+  public:
+  using iterator = typename index_permutation_level_view<IDX>::iterator;
+
+  index_permutation_table() : N(0), L(0), COUNT(0) {}
+  index_permutation_table(const size_t N, const size_t L) 
+    : N(N), L(L), COUNT(num_unique_permutations(N,L)), SWAPS(COUNT*L) {}
+  //COUNT lists of L swaps that are not a single unique permutation level
+  index_permutation_table(const size_t N, const size_t L, const size_t COUNT) 
+    : N(N), L(L), COUNT(COUNT), SWAPS(COUNT*L) {}
+
+  index_permutation_level_view<IDX> view() const {return {SWAPS.data(),L,COUNT};}
+  index_permutation_span<IDX> operator[](const size_t K) const {return {SWAPS.data() + K*L,L};}
+  iterator begin() const {return view().begin();}
+  iterator end() const {return view().end();}
+  size_t size() const {return COUNT;}
+  size_t level() const {return L;}
+  size_t num_indices() const {return N;}
+
+  basic_index_permutation<IDX>* data() {return SWAPS.data();}
+  const basic_index_permutation<IDX>* data() const {return SWAPS.data();}
+
+  private:
+  size_t N;
+  size_t L;
+  size_t COUNT;
+  std::vector<basic_index_permutation<IDX>> SWAPS;
+};
+
+//compile-time (N,L) fill of a flat buffer
+template<typename IDX, int N, int L>
+void fill_unique_permutations_flat(basic_index_permutation<IDX>* OUT) {
+  const size_t COUNT = num_unique_permutations(N,L);
+  if (L == 0 || COUNT == 0) {
+    return;
+  }
+
+  index_permutation_list<L,IDX> PLIST;
+  first_unique_permutation<N,L>(PLIST);
+  for (size_t K=0; K < COUNT; K++) {
+    std::copy(PLIST.begin(),PLIST.end(),OUT + K*L);
+    next_unique_permutation<N,L>(PLIST);
+  }
+}
+
+template<typename IDX>
+using fill_unique_permutations_fn = void (*)(basic_index_permutation<IDX>*);
+
+template<typename IDX, int N, size_t... LS>
+fill_unique_permutations_fn<IDX> dispatch_fill_level(const size_t L, std::index_sequence<LS...>) {
+  static constexpr fill_unique_permutations_fn<IDX> TABLE[] = {
+    &fill_unique_permutations_flat<IDX,N,static_cast<int>(LS)>...};
+  return TABLE[L];
+}
+
+template<typename IDX, int N>
+fill_unique_permutations_fn<IDX> dispatch_fill_n(const size_t L) {
+  return dispatch_fill_level<IDX,N>(L,std::make_index_sequence<N>());
+}
+
+//returns the specialized fill for 1 <= N <= UPERM_DISPATCH_MAX_N, L < N
+template<typename IDX, size_t... NS>
+fill_unique_permutations_fn<IDX> dispatch_fill(const size_t N, const size_t L, 
+                                               std::index_sequence<NS...>) {
+  using level_fn = fill_unique_permutations_fn<IDX> (*)(const size_t);
+  static constexpr level_fn TABLE[] = {&dispatch_fill_n<IDX,static_cast<int>(NS)+1>...};
+  return TABLE[N-1](L);
+}
+
+/* 
+  returns all permutations of N indices at level L, with N and L known
+  only at runtime, in the order of get_all_unique_permutations<N,L>
+*/
+template<typename IDX = size_t>
+index_permutation_table<IDX> get_all_unique_permutations(const size_t N, const size_t L) {
+  UPERM_STATS_TIMER(N,L);
+  index_permutation_table<IDX> OUT(N,L);
+  UPERM_STATS_ADD(BYTES,N,L,OUT.size()*L*sizeof(basic_index_permutation<IDX>));
+  if (L == 0 || OUT.size() == 0) {
+    return OUT;
+  }
+
+  if (N <= UPERM_DISPATCH_MAX_N) {
+    dispatch_fill<IDX>(N,L,std::make_index_sequence<UPERM_DISPATCH_MAX_N>())(OUT.data());
+  } else {
+    fill_unique_permutations(static_cast<int>(N),static_cast<int>(L),OUT.data());
+  }
+  return OUT;
+}
+
+//generic depth X of the runtime apply_all_permutations tree walk
+template<class T, typename Visitor>
+void apply_all_permutations_runtime_loop(const size_t N, const size_t L, const size_t X, 
+                                 const size_t MIN, T& DATA, index_permutation* PLIST,
+                                 Visitor& VISIT) {
+  if (X == L) {
+    VISIT(static_cast<const T&>(DATA),index_permutation_span<size_t>{PLIST,L});
+    return;
+  }
+
+  for (size_t I=MIN; I < N - L + X; I++) {
+    for (size_t J=I+1; J < N; J++) {
+      std::iter_swap(DATA.begin()+I,DATA.begin()+J);
+      PLIST[X] = {I,J};
+      apply_all_permutations_runtime_loop(N,L,X+1,I+1,DATA,PLIST,VISIT);
+      std::iter_swap(DATA.begin()+I,DATA.begin()+J);
+    }
+  }
+}
+
+//compile-time (N,L) walk, handing the visitor a span like the generic one
+template<int N, int L, class T, typename Visitor>
+void apply_all_permutations_spans(T& DATA, Visitor& VISIT) {
+  apply_all_permutations<N,L>(DATA, 
+    [&VISIT](const T& PERMUTED, const index_permutation_list<L>& PLIST) {
+      VISIT(PERMUTED,index_permutation_span<size_t>{PLIST.data(),L});
+    });
+}
+
+template<class T, typename Visitor>
+using apply_all_permutations_fn = void (*)(T&, Visitor&);
+
+template<class T, typename Visitor, int N, size_t... LS>
+apply_all_permutations_fn<T,Visitor> dispatch_apply_level(const size_t L, std::index_sequence<LS...>) {
+  static constexpr apply_all_permutations_fn<T,Visitor> TABLE[] = {
+    &apply_all_permutations_spans<N,static_cast<int>(LS),T,Visitor>...};
+  return TABLE[L];
+}
+
+template<class T, typename Visitor, int N>
+apply_all_permutations_fn<T,Visitor> dispatch_apply_n(const size_t L) {
+  return dispatch_apply_level<T,Visitor,N>(L,std::make_index_sequence<N>());
+}
+
+template<class T, typename Visitor, size_t... NS>
+apply_all_permutations_fn<T,Visitor> dispatch_apply(const size_t N, const size_t L, 
+                                                    std::index_sequence<NS...>) {
+  using level_fn = apply_all_permutations_fn<T,Visitor> (*)(const size_t);
+  static constexpr level_fn TABLE[] = {&dispatch_apply_n<T,Visitor,static_cast<int>(NS)+1>...};
+  return TABLE[N-1](L);
+}
+
+/*
+  apply_all_permutations with N and L known only at runtime. 
+  VISIT(PERMUTED, PLIST) receives the list as an index_permutation_span
+*/
+template<class T, typename Visitor>
+void apply_all_permutations(const size_t N, const size_t L, T& DATA, Visitor&& VISIT) {
+  if (N == 0 || L > N - 1) {
+    return;
+  }
+
+  using visitor_type = typename std::remove_reference<Visitor>::type;
+  if (N <= UPERM_DISPATCH_MAX_N) {
+    dispatch_apply<T,visitor_type>(N,L,std::make_index_sequence<UPERM_DISPATCH_MAX_N>())(DATA,VISIT);
+  } else {
+    UPERM_STATS_ADD(SWAPS,N,L,tree_walk_swaps(N,L));
+    std::vector<index_permutation> PLIST(L);
+    apply_all_permutations_runtime_loop(N,L,0,0,DATA,PLIST.data(),VISIT);
+  }
+}
+
+
+/*
+  Minimal change order
+
+  An alternative order of the level L lists in which consecutive lists
+  compose to permutations that differ by at most two transpositions, so 
+  a single working copy can be updated in place instead of applying
+  every list from scratch.
+
+  A level L list is a choice, for each LHS position p = 0..N-2, of either
+  no swap or a swap (p,J) with p < J < N, with exactly L swaps chosen. 
+  Changing the J of one position, or dropping the swap of one position
+  while adding one at another, changes the composed permutation by a 
+  conjugated 3-cycle or pair of transpositions, i.e. at most two swaps.
+  The order below only makes such moves:
+    - the chosen positions follow the revolving door Gray code of 
+      L-combinations (Knuth, TAOCP 7.2.1.3, Algorithm R), which drops
+      one position and adds another at each step
+    - for each combination the J's follow a reflected mixed radix Gray 
+      code (Algorithm H), which changes one J at each step, started 
+      from the J's the previous combination ended on
+
+  minimal_change_permutations is a cursor over this order. After each
+  step, permutation() is the current list (in the same canonical form
+  as get_all_unique_permutations) and delta() the swaps that take
+  execute_permutations(previous list, IN) to
+  execute_permutations(permutation(), IN). For the first list, delta()
+  takes IN itself to it.
+*/
+template<int N, int L>
+class minimal_change_permutations {
+  public:
+  //swaps in one delta, the first one may need all L
+  static constexpr size_t MAX_DELTA = (L > 2) ? L : 2;
+
+  minimal_change_permutations() : K(0), COUNT(num_unique_permutations(N,L)), NDELTA(0) {
+    for (size_t I=0; I < static_cast<size_t>(N); I++) {
+      MAP[I] = I;
+      INV[I] = I;
+    }
+    if (COUNT == 0) {
+      return;
+    }
+
+    //revolving door start: positions 0..L-1, c[L+1] = N-1 is a sentinel
+    for (int X=1; X <= L; X++) {
+      C[X] = X - 1;
+    }
+    C[L+1] = N - 1;
+    for (size_t P=0; P+1 < static_cast<size_t>(N); P++) {
+      VAL[P] = P + 1;
+    }
+    start_gray();
+    update();
+  }
+
+  const index_permutation_list<L>& permutation() const {return PLIST;}
+  index_permutation_span<size_t> delta() const {return {DELTA.data(),NDELTA,L};}
+
+  //position of the current list in this order, and the number of lists
+  size_t index() const {return K;}
+  size_t size() const {return COUNT;}
+
+  //moves to the next list, returns false past the last one
+  bool next() {
+    if (K >= COUNT) {
+      return false;
+    }
+    K++;
+    if (K == COUNT) {
+      NDELTA = 0;
+      return false;
+    }
+    if (!next_gray()) {
+      next_combination();
+      start_gray();
+    }
+    update();
+    return true;
+  }
+
+  private:
+  //chosen LHS positions, 1 based as in Algorithm R: C[1] < ... < C[L]
+  size_t C[L+2];
+  //J of each LHS position, kept while the position is not chosen 
+  std::array<size_t,(N > 1) ? N-1 : 1> VAL;
+
+  //Gray code over the chosen positions with more than one J
+  size_t M = 0;
+  size_t POS[L+1];
+  size_t RADIX[L+1];
+  size_t BASE[L+1];
+  size_t DIGIT[L+1];
+  int DIR[L+1];
+  size_t FOCUS[L+2];
+
+  size_t K;
+  size_t COUNT;
+  index_permutation_list<L> PLIST;
+  std::array<size_t,N> MAP;
+  std::array<size_t,N> INV;
+  std::array<index_permutation,MAX_DELTA> DELTA;
+  size_t NDELTA;
+
+  void start_gray() {
+    M = 0;
+    for (int X=1; X <= L; X++) {
+      const size_t P = C[X];
+      if (N - 1 - P > 1) {
+        POS[M] = P;
+        RADIX[M] = N - 1 - P;
+        BASE[M] = VAL[P] - P - 1;
+        DIGIT[M] = 0;
+        DIR[M] = 1;
+        M++;
+      }
+    }
+    for (size_t X=0; X <= M; X++) {
+      FOCUS[X] = X;
+    }
+  }
+
+  //Algorithm H, one J changes
+  bool next_gray() {
+    const size_t X = FOCUS[0];
+    FOCUS[0] = 0;
+    if (X == M) {
+      return false;
+    }
+
+    DIGIT[X] += DIR[X];
+    if (DIGIT[X] == 0 || DIGIT[X] == RADIX[X] - 1) {
+      DIR[X] = -DIR[X];
+      FOCUS[X] = FOCUS[X+1];
+      FOCUS[X+1] = X + 1;
+    }
+    VAL[POS[X]] = POS[X] + 1 + (BASE[X] + DIGIT[X]) % RADIX[X];
+    return true;
+  }
+
+  //Algorithm R, one position is swapped for another
+  void next_combination() {
+    const size_t NP = N - 1;
+    size_t ADDED = 0;
+    if (L == 1) {
+      C[1]++;
+      ADDED = C[1];
+    } else if (L % 2 == 1 && C[1] + 1 < C[2]) {
+      C[1]++;
+      ADDED = C[1];
+    } else if (L % 2 == 0 && C[1] > 0) {
+      C[1]--;
+      ADDED = C[1];
+    } else {
+      size_t J = 2;
+      bool INCREASE = (L % 2 == 0);
+      while (J <= static_cast<size_t>(L)) {
+        if (!INCREASE) {
+          //R4, try to decrease C[J]
+          if (C[J] >= J) {
+            C[J] = C[J-1];
+            C[J-1] = J - 2;
+            ADDED = J - 2;
+            break;
+          }
+          J++;
+        } 
+        //R5, try to increase C[J]
+        const size_t NEXT = (J == static_cast<size_t>(L)) ? NP : C[J+1];
+        if (C[J] + 1 < NEXT) {
+          C[J-1] = C[J];
+          C[J]++;
+          ADDED = C[J];
+          break;
+        }
+        J++;
+        INCREASE = false;
+      }
+    }
+    VAL[ADDED] = ADDED + 1;
+  }
+
+  //rebuilds PLIST, and the delta from the previous composed map
+  void update() {
+    for (int X=0; X < L; X++) {
+      PLIST[X] = {C[X+1],VAL[C[X+1]]};
+    }
+
+    std::array<size_t,N> NEW;
+    for (size_t I=0; I < static_cast<size_t>(N); I++) {
+      NEW[I] = I;
+    }
+    for (auto const& perm : PLIST) {
+      std::swap(NEW[perm.first],NEW[perm.second]);
+    }
+
+    //positions of the old output that the new output gathers from
+    std::array<size_t,N> CUR, WHERE, D;
+    for (size_t I=0; I < static_cast<size_t>(N); I++) {
+      D[I] = INV[NEW[I]];
+      CUR[I] = I;
+      WHERE[I] = I;
+    }
+    NDELTA = 0;
+    for (size_t I=0; I < static_cast<size_t>(N); I++) {
+      if (CUR[I] != D[I]) {
+        const size_t J = WHERE[D[I]];
+        DELTA[NDELTA++] = {I,J};
+        std::swap(CUR[I],CUR[J]);
+        WHERE[CUR[I]] = I;
+        WHERE[CUR[J]] = J;
+      }
+    }
+
+    MAP = NEW;
+    for (size_t I=0; I < static_cast<size_t>(N); I++) {
+      INV[MAP[I]] = I;
+    }
+  }
+};
+
+//range over the minimal change order, dereferencing to the cursor
+template<int N, int L>
+class minimal_change_permutation_range {
+  public:
+  class iterator {
+    public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = minimal_change_permutations<N,L>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    iterator() : CURSOR(nullptr) {}
+    explicit iterator(minimal_change_permutations<N,L>* CURSOR) : CURSOR(CURSOR) {
+      if (CURSOR != nullptr && CURSOR->index() >= CURSOR->size()) {
+        this->CURSOR = nullptr;
+      }
+    }
+
+    reference operator*() const {return *CURSOR;}
+    pointer operator->() const {return CURSOR;}
+    iterator& operator++() {
+      if (!CURSOR->next()) {
+        CURSOR = nullptr;
+      }
+      return *this;
+    }
+
+    bool operator==(const iterator& OTHER) const {return CURSOR == OTHER.CURSOR;}
+    bool operator!=(const iterator& OTHER) const {return CURSOR != OTHER.CURSOR;}
+
+    private:
+    minimal_change_permutations<N,L>* CURSOR;
+  };
+
+  iterator begin() {return iterator(&CURSOR);}
+  iterator end() {return iterator();}
+  size_t size() const {return CURSOR.size();}
+
+  private:
+  minimal_change_permutations<N,L> CURSOR;
+};
+
+
+/*
+  Batched structure-of-arrays apply
+
+  A batch of B inputs of N elements is stored as N columns of B rows,
+  element C of input R at IN[C*LD + R]. Permuting every input by the
+  same list only reorders whole columns, so the swaps are done once on
+  the column indices and each output column is one contiguous copy of
+  an input column, which vectorizes across B.
+*/
+
+//returns the column pointers permuted by PLIST, a zero copy view
+template<typename IDX, size_t L, typename T, size_t N>
+std::array<T*,N> permute_columns(const std::array<basic_index_permutation<IDX>,L>& PLIST,
+                                 std::array<T*,N> COLS) {
+  for (auto const& perm : PLIST) {
+    std::swap(COLS[perm.first],COLS[perm.second]);
+  }
+  return COLS;
+}
+
+//copies input column SRC[C] to output column C, for all N columns
+template<int N, typename SRC_IDX, typename T>
+void gather_columns(const std::array<SRC_IDX,N>& SRC, const T* IN, const size_t IN_LD,
+                    T* OUT, const size_t OUT_LD, const size_t B) {
+  for (size_t C=0; C < static_cast<size_t>(N); C++) {
+    const T* COL = IN + static_cast<size_t>(SRC[C]) * IN_LD;
+    std::copy(COL,COL + B,OUT + C * OUT_LD);
+  }
+}
+
+/*
+  OUT row R = execute_permutations(PLIST, IN row R) for all B rows. 
+  IN and OUT are N x B column major with leading dimensions IN_LD and 
+  OUT_LD (B by default), they must not overlap
+*/
+template<int N, typename IDX, size_t L, typename T>
+void execute_permutations_batched(const std::array<basic_index_permutation<IDX>,L>& PLIST,
+                                  const T* IN, T* OUT, const size_t B,
+                                  const size_t IN_LD = 0, const size_t OUT_LD = 0) {
+  std::array<size_t,N> SRC;
+  for (size_t C=0; C < static_cast<size_t>(N); C++) {
+    SRC[C] = C;
+  }
+  for (auto const& perm : PLIST) {
+    std::swap(SRC[perm.first],SRC[perm.second]);
+  }
+  UPERM_STATS_ADD(SWAPS,N,L,L);
+  UPERM_STATS_ADD(COPIES,N,L,B);
+  gather_columns<N>(SRC,IN,IN_LD ? IN_LD : B,OUT,OUT_LD ? OUT_LD : B,B);
+}
+
+//as above, for a runtime length list
+template<int N, typename IDX, typename T>
+void execute_permutations_batched(const index_permutation_span<IDX>& PLIST,
+                                  const T* IN, T* OUT, const size_t B,
+                                  const size_t IN_LD = 0, const size_t OUT_LD = 0) {
+  std::array<size_t,N> SRC;
+  for (size_t C=0; C < static_cast<size_t>(N); C++) {
+    SRC[C] = C;
+  }
+  for (auto const& perm : PLIST) {
+    std::swap(SRC[perm.first],SRC[perm.second]);
+  }
+  UPERM_STATS_ADD(SWAPS,N,PLIST.level(),PLIST.size());
+  UPERM_STATS_ADD(COPIES,N,PLIST.level(),B);
+  gather_columns<N>(SRC,IN,IN_LD ? IN_LD : B,OUT,OUT_LD ? OUT_LD : B,B);
+}
+
+//as above, for a list already composed to an index map
+template<int N, typename T>
+void execute_permutations_batched(const index_map<N>& MAP,
+                                  const T* IN, T* OUT, const size_t B,
+                                  const size_t IN_LD = 0, const size_t OUT_LD = 0) {
+  UPERM_STATS_ADD(COPIES,N,index_map_level(MAP),B);
+  gather_columns<N>(MAP,IN,IN_LD ? IN_LD : B,OUT,OUT_LD ? OUT_LD : B,B);
+}
+
+/*
+  applies every list of TABLE (a vector of lists, a level view or 
+  runtime table, or a vector of index maps) to the batch. The outputs of list K are written as the K-th
+  N x B block of OUT, at OUT + K*N*B
+*/
+template<int N, typename Table, typename T>
+void execute_all_permutations_batched(const Table& TABLE, const T* IN, T* OUT,
+                                      const size_t B) {
+  size_t K = 0;
+  for (auto const& PLIST : TABLE) {
+    execute_permutations_batched<N>(PLIST,IN,OUT + K*N*B,B);
+    K++;
+  }
+}
+
+
+/*
+  In place application
+
+  execute_permutations copies IN into a fresh T for every list. These 
+  permute DATA itself instead: apply a list, consume the result, then
+  undo it (the same swaps in reverse order) to get DATA back.
+
+  This requires the class to have a .begin() iterator
+*/
+template<class T, typename IDX, size_t L>
+void execute_permutations_inplace(const std::array<basic_index_permutation<IDX>,L>& PLIST,
+                                  T& DATA) {
+  UPERM_STATS_ADD(SWAPS,DATA.size(),PLIST.size(),PLIST.size());
+  for (auto const& perm : PLIST) {
+    std::iter_swap(DATA.begin()+perm.first,DATA.begin()+perm.second);
+  }
+}
+
+template<class T, typename IDX, size_t L>
+void undo_permutations_inplace(const std::array<basic_index_permutation<IDX>,L>& PLIST,
+                               T& DATA) {
+  UPERM_STATS_ADD(SWAPS,DATA.size(),PLIST.size(),PLIST.size());
+  for (auto perm = PLIST.rbegin(); perm != PLIST.rend(); ++perm) {
+    std::iter_swap(DATA.begin()+perm->first,DATA.begin()+perm->second);
+  }
+}
+
+//as above, for runtime length lists
+template<class T, typename IDX>
+void execute_permutations_inplace(const index_permutation_span<IDX>& PLIST, T& DATA) {
+  UPERM_STATS_ADD(SWAPS,DATA.size(),PLIST.level(),PLIST.size());
+  for (auto const& perm : PLIST) {
+    std::iter_swap(DATA.begin()+perm.first,DATA.begin()+perm.second);
+  }
+}
+
+template<class T, typename IDX>
+void undo_permutations_inplace(const index_permutation_span<IDX>& PLIST, T& DATA) {
+  UPERM_STATS_ADD(SWAPS,DATA.size(),PLIST.level(),PLIST.size());
+  for (size_t X=PLIST.size(); X > 0; X--) {
+    std::iter_swap(DATA.begin()+PLIST[X-1].first,DATA.begin()+PLIST[X-1].second);
+  }
+}
+
+/*
+  calls VISIT(PERMUTED, PLIST) for every list of TABLE, where PERMUTED
+  is DATA with PLIST applied in place. DATA is restored after each 
+  visit, so no T is copied and nothing is allocated. VISIT must not
+  modify DATA
+*/
+template<typename Table, class T, typename Visitor>
+void for_each_permutation(const Table& TABLE, T& DATA, Visitor&& VISIT) {
+  for (auto const& PLIST : TABLE) {
+    execute_permutations_inplace(PLIST,DATA);
+    VISIT(static_cast<const T&>(DATA),PLIST);
+    undo_permutations_inplace(PLIST,DATA);
+  }
+}
+
+/*
+  as above over every level L list of N indices, generated on the fly
+  by unique_permutation_range. apply_all_permutations visits the same
+  lists in the same order and also shares the swaps of common prefixes
+*/
+template<int N, int L, class T, typename Visitor>
+void for_each_permutation(T& DATA, Visitor&& VISIT) {
+  for_each_permutation(unique_permutation_range<N,L>(),DATA,VISIT);
+}
+
+
+/*
+  Classifying arbitrary permutations
+
+  P is a permuted index array, P[i] being the index that ends up at 
+  position i, as execute_permutations(PLIST,{0,1,...,N-1}) produces. 
+  The canonical list of P is recovered left to right: positions before
+  the LHS index of a swap are never touched again, so the first 
+  position i still missing P[i] is the next LHS index, and the current
+  position of P[i] its partner. Its length is the level, N minus the
+  number of cycles of P, and rank_unique_permutation gives its 
+  position in the level table. Both are O(N).
+*/
+struct permutation_class {
+  size_t level;
+  size_t rank;
+};
+
+/*
+  writes the canonical list of the N entry index array P to PLIST (room
+  for N-1 swaps) and returns its level. LOC and WHO are N entries of 
+  scratch. P must be a permutation of 0..N-1
+*/
+template<typename Container, typename IDX, typename SCRATCH>
+size_t decompose_permutation(const Container& P, const size_t N, 
+                             basic_index_permutation<IDX>* PLIST,
+                             SCRATCH* LOC, SCRATCH* WHO) {
+  for (size_t I=0; I < N; I++) {
+    LOC[I] = static_cast<SCRATCH>(I);
+    WHO[I] = static_cast<SCRATCH>(I);
+  }
+
+  size_t L = 0;
+  for (size_t I=0; I < N; I++) {
+    const size_t J = LOC[P[I]];
+    if (J != I) {
+      PLIST[L++] = {static_cast<IDX>(I),static_cast<IDX>(J)};
+      const SCRATCH MOVED = WHO[I];
+      WHO[J] = MOVED;
+      LOC[MOVED] = static_cast<SCRATCH>(J);
+      WHO[I] = static_cast<SCRATCH>(P[I]);
+      LOC[P[I]] = static_cast<SCRATCH>(I);
+    }
+  }
+  return L;
+}
+
+//level and rank of a fixed size index array, without allocating
+template<typename IDX, size_t N>
+permutation_class classify_permutation(const std::array<IDX,N>& P) {
+  std::array<index_permutation,(N > 1) ? N-1 : 1> PLIST;
+  std::array<size_t,N> LOC, WHO;
+  const size_t L = decompose_permutation(P,N,PLIST.data(),LOC.data(),WHO.data());
+  return {L,rank_unique_permutation(N,L,PLIST.data())};
+}
+
+//level and rank of any index array with size() and operator[]
+template<typename Container>
+permutation_class classify_permutation(const Container& P) {
+  const size_t N = P.size();
+  std::vector<index_permutation> PLIST(N);
+  std::vector<size_t> LOC(N), WHO(N);
+  const size_t L = decompose_permutation(P,N,PLIST.data(),LOC.data(),WHO.data());
+  return {L,rank_unique_permutation(N,L,PLIST.data())};
+}
+
+
+/*
+  Group restricted generation
+
+  For blocked index spaces (e.g. occupied and virtual indices of a 
+  tensor) only permutations within a group are allowed. Given a 
+  partition of 0..N-1 into GROUPS and a level per group, the lists are
+  the products P_0 P_1 ... of one level LEVELS[g] list per group g, 
+  built directly from the per group sequences rather than by filtering
+  the full level. Each list holds the swaps of group 0 first, then 
+  group 1, and so on; swaps of different groups commute. The last group
+  varies fastest.
+*/
+
+//number of group restricted lists, the product of the per group counts
+inline size_t num_group_unique_permutations(const std::vector<std::vector<size_t>>& GROUPS,
+                                            const std::vector<size_t>& LEVELS) {
+  size_t COUNT = 1;
+  for (size_t G=0; G < GROUPS.size(); G++) {
+    COUNT *= num_unique_permutations(GROUPS[G].size(),LEVELS[G]);
+  }
+  return COUNT;
+}
+
+template<typename IDX = size_t>
+index_permutation_table<IDX> get_group_unique_permutations(const std::vector<std::vector<size_t>>& GROUPS,
+                                                          const std::vector<size_t>& LEVELS) {
+  size_t N = 0;
+  size_t L = 0;
+  std::vector<size_t> START(GROUPS.size());
+  for (size_t G=0; G < GROUPS.size(); G++) {
+    START[G] = L;
+    N += GROUPS[G].size();
+    L += LEVELS[G];
+  }
+
+  const size_t COUNT = num_group_unique_permutations(GROUPS,LEVELS);
+  index_permutation_table<IDX> OUT(N,L,COUNT);
+  if (COUNT == 0 || L == 0) {
+    return OUT;
+  }
+
+  //current local list of each group, in its own 0..size-1 indices
+  std::vector<index_permutation> LOCAL(L);
+  for (size_t G=0; G < GROUPS.size(); G++) {
+    first_unique_permutation(static_cast<int>(LEVELS[G]),LOCAL.data() + START[G]);
+  }
+
+  basic_index_permutation<IDX>* ELEMENT = OUT.data();
+  for (size_t K=0; K < COUNT; K++) {
+    for (size_t G=0; G < GROUPS.size(); G++) {
+      for (size_t X=START[G]; X < START[G] + LEVELS[G]; X++) {
+        *ELEMENT++ = {static_cast<IDX>(GROUPS[G][LOCAL[X].first]),
+                      static_cast<IDX>(GROUPS[G][LOCAL[X].second])};
+      }
+    }
+
+    //odometer step, a group that wraps around carries into the one before
+    for (size_t G=GROUPS.size(); G > 0; G--) {
+      if (next_unique_permutation(static_cast<int>(GROUPS[G-1].size()),static_cast<int>(LEVELS[G-1]),
+                                  LOCAL.data() + START[G-1])) {
+        break;
+      }
+    }
+  }
+
+  return OUT;
+}
+
+
+/*
+  Streaming generation
+
+  For levels too large to materialize, stream_unique_permutations 
+  generates the sequence on the calling thread in blocks of BLOCK_SIZE
+  lists and hands them to NCONSUMERS threads through bounded lock free
+  queues, so generation overlaps the consumers' work and memory stays 
+  at NBLOCKS blocks whatever the level size. Each block is passed as
+
+    CONSUME(const index_permutation_list<L,IDX>* BEGIN,
+            const index_permutation_list<L,IDX>* END, size_t FIRST_RANK)
+
+  concurrently from the consumer threads, FIRST_RANK being the position
+  of *BEGIN in the level L sequence. Blocks may complete in any order.
+  A BLOCK_SIZE of 0 is taken as 1.
+*/
+#ifndef UPERM_STREAM_BLOCK_SIZE
+#define UPERM_STREAM_BLOCK_SIZE 4096
+#endif
+
+/*
+  bounded multi-producer multi-consumer queue (D. Vyukov's array queue).
+  Each cell carries a sequence number telling producers and consumers 
+  whose turn it is, so push and pop are one CAS and never block. The
+  capacity is rounded up to a power of two
+*/
+template<typename T>
+class bounded_mpmc_queue {
+public:
+  explicit bounded_mpmc_queue(const size_t CAPACITY) 
+    : CELLS(round_capacity(CAPACITY)), MASK(CELLS.size() - 1), ENQUEUE(0), DEQUEUE(0) {
+    for (size_t K=0; K < CELLS.size(); K++) {
+      CELLS[K].SEQUENCE.store(K,std::memory_order_relaxed);
+    }
+  }
+  bounded_mpmc_queue(const bounded_mpmc_queue&) = delete;
+  bounded_mpmc_queue& operator=(const bounded_mpmc_queue&) = delete;
+
+  //returns false if the queue is full
+  bool try_push(const T& VALUE) {
+    size_t POS = ENQUEUE.load(std::memory_order_relaxed);
+    for (;;) {
+      cell& C = CELLS[POS & MASK];
+      const size_t SEQUENCE = C.SEQUENCE.load(std::memory_order_acquire);
+      const std::ptrdiff_t DIFF = static_cast<std::ptrdiff_t>(SEQUENCE - POS);
+      if (DIFF == 0) {
+        if (ENQUEUE.compare_exchange_weak(POS,POS + 1,std::memory_order_relaxed)) {
+          C.VALUE = VALUE;
+          C.SEQUENCE.store(POS + 1,std::memory_order_release);
+          return true;
+        }
+      } else if (DIFF < 0) {
+        return false;
+      } else {
+        POS = ENQUEUE.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  //returns false if the queue is empty
+  bool try_pop(T& VALUE) {
+    size_t POS = DEQUEUE.load(std::memory_order_relaxed);
+    for (;;) {
+      cell& C = CELLS[POS & MASK];
+      const size_t SEQUENCE = C.SEQUENCE.load(std::memory_order_acquire);
+      const std::ptrdiff_t DIFF = static_cast<std::ptrdiff_t>(SEQUENCE - (POS + 1));
+      if (DIFF == 0) {
+        if (DEQUEUE.compare_exchange_weak(POS,POS + 1,std::memory_order_relaxed)) {
+          VALUE = C.VALUE;
+          C.SEQUENCE.store(POS + MASK + 1,std::memory_order_release);
+          return true;
+        }
+      } else if (DIFF < 0) {
+        return false;
+      } else {
+        POS = DEQUEUE.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  //spinning versions, yield until there is room or a value
+  void push(const T& VALUE) {
+    while (!try_push(VALUE)) {
+      std::this_thread::yield();
+    }
+  }
+
+  void pop(T& VALUE) {
+    while (!try_pop(VALUE)) {
+      std::this_thread::yield();
+    }
+  }
+
+  size_t capacity() const { return CELLS.size(); }
+
+private:
+  struct cell {
+    std::atomic<size_t> SEQUENCE;
+    T VALUE;
+  };
+
+  static size_t round_capacity(const size_t CAPACITY) {
+    size_t C = 2;
+    while (C < CAPACITY) {
+      C *= 2;
+    }
+    return C;
+  }
+
+  std::vector<cell> CELLS;
+  const size_t MASK;
+  //producers and consumers update different cache lines
+  alignas(64) std::atomic<size_t> ENQUEUE;
+  alignas(64) std::atomic<size_t> DEQUEUE;
+};
+
+/*
+  NCONSUMERS = 0 uses hardware_concurrency - 1 consumers (at least 1). 
+  NBLOCKS = 0 keeps 2 blocks per consumer in flight, plus one being
+  generated
+*/
+template<int N, int L, typename IDX = size_t, typename Consumer>
+void stream_unique_permutations(Consumer&& CONSUME, unsigned NCONSUMERS = 0,
+                                size_t BLOCK_SIZE = UPERM_STREAM_BLOCK_SIZE,
+                                size_t NBLOCKS = 0) {
+  using list_type = index_permutation_list<L,IDX>;
+  struct block {
+    list_type* BEGIN;
+    size_t SIZE;  //0 tells a consumer to stop
+    size_t FIRST;
+  };
+
+  const size_t COUNT = num_unique_permutations(N,L);
+  if (NCONSUMERS == 0) {
+    NCONSUMERS = std::max(2u,std::thread::hardware_concurrency()) - 1;
+  }
+  if (NBLOCKS == 0) {
+    NBLOCKS = 2*static_cast<size_t>(NCONSUMERS) + 1;
+  }
+  //an empty block is the stop signal, so blocks hold at least one list
+  BLOCK_SIZE = std::max<size_t>(BLOCK_SIZE,1);
+
+  std::vector<list_type> STORAGE(NBLOCKS*BLOCK_SIZE);
+  bounded_mpmc_queue<block> FREE(NBLOCKS);
+  bounded_mpmc_queue<block> FULL(NBLOCKS + NCONSUMERS);
+  for (size_t B=0; B < NBLOCKS; B++) {
+    FREE.push({STORAGE.data() + B*BLOCK_SIZE, 0, 0});
+  }
+
+  std::vector<std::thread> CONSUMERS;
+  CONSUMERS.reserve(NCONSUMERS);
+  for (unsigned C=0; C < NCONSUMERS; C++) {
+    CONSUMERS.emplace_back([&FREE,&FULL,&CONSUME]() {
+      block B;
+      for (;;) {
+        FULL.pop(B);
+        if (B.SIZE == 0) {
+          return;
+        }
+        CONSUME(static_cast<const list_type*>(B.BEGIN),
+                static_cast<const list_type*>(B.BEGIN + B.SIZE),B.FIRST);
+        FREE.push(B);
+      }
+    });
+  }
+
+  list_type PLIST{};
+  first_unique_permutation<N,L>(PLIST);
+  for (size_t FIRST=0; FIRST < COUNT; ) {
+    block B;
+    FREE.pop(B);
+    B.SIZE = std::min(BLOCK_SIZE,COUNT - FIRST);
+    B.FIRST = FIRST;
+    for (size_t K=0; K < B.SIZE; K++) {
+      B.BEGIN[K] = PLIST;
+      next_unique_permutation<N,L>(PLIST);
+    }
+    FULL.push(B);
+    FIRST += B.SIZE;
+  }
+
+  for (unsigned C=0; C < NCONSUMERS; C++) {
+    FULL.push({nullptr, 0, 0});
+  }
+  for (auto& consumer : CONSUMERS) {
+    consumer.join();
+  }
+}
+
+
+/*
+  Multiset inputs
+
+  When the input holds repeated values, many lists give the same output.
+  With CLASSES[i] the equivalence class of input element i, every 
+  distinct output is produced by exactly one stable permutation, the 
+  one keeping equal elements in their original relative order, and 
+  only those lists are emitted: the level L ones here, so that over all
+  levels each distinct output appears once. 
+
+  The tree is walked as in apply_all_permutations on a working copy W 
+  of the source indices. Positions before the current LHS index are 
+  never touched again, so each is checked as soon as it is final, and
+  a position breaking the order of its class prunes the whole subtree.
+*/
+class distinct_permutation_walk {
+public:
+  distinct_permutation_walk(const std::vector<size_t>& CLASSES, const size_t L) 
+    : N(CLASSES.size()), L(L), CLASS(CLASSES), W(N), PLIST(L) {
+    //labels are arbitrary ids, renumber them 0..k-1 so NEXT holds one slot per class
+    std::vector<size_t> LABELS = CLASSES;
+    std::sort(LABELS.begin(),LABELS.end());
+    LABELS.erase(std::unique(LABELS.begin(),LABELS.end()),LABELS.end());
+    for (size_t I=0; I < N; I++) {
+      W[I] = I;
+      CLASS[I] = std::lower_bound(LABELS.begin(),LABELS.end(),CLASSES[I]) - LABELS.begin();
+    }
+    NEXT.assign(LABELS.size(),0);
+    UNDO.reserve(N);
+  }
+
+  //calls VISIT(const index_permutation* PLIST) for each stable level L list, in sequence order
+  template<typename Visitor>
+  void run(Visitor&& VISIT) {
+    if (L == 0 || L < N) {
+      loop(0,0,VISIT);
+    }
+  }
+
+private:
+  //position P is final: its source must come after the last one of its class
+  bool finalize(const size_t P) {
+    const size_t C = CLASS[W[P]];
+    if (W[P] < NEXT[C]) {
+      return false;
+    }
+    UNDO.push_back({C,NEXT[C]});
+    NEXT[C] = W[P] + 1;
+    return true;
+  }
+
+  void undo_to(const size_t MARK) {
+    while (UNDO.size() > MARK) {
+      NEXT[UNDO.back().first] = UNDO.back().second;
+      UNDO.pop_back();
+    }
+  }
+
+  template<typename Visitor>
+  void loop(const size_t X, const size_t MIN, Visitor& VISIT) {
+    const size_t MARK = UNDO.size();
+    if (X == L) {
+      bool STABLE = true;
+      for (size_t P=MIN; P < N && STABLE; P++) {
+        STABLE = finalize(P);
+      }
+      if (STABLE) {
+        VISIT(static_cast<const index_permutation*>(PLIST.data()));
+      }
+      undo_to(MARK);
+      return;
+    }
+
+    for (size_t I=MIN; I < N - L + X; I++) {
+      //moving the LHS index past I-1 makes position I-1 final for every larger I too
+      if (I > MIN && !finalize(I-1)) {
+        break;
+      }
+      for (size_t J=I+1; J < N; J++) {
+        std::swap(W[I],W[J]);
+        PLIST[X] = {I,J};
+        const size_t INNER = UNDO.size();
+        if (finalize(I)) {
+          loop(X+1,I+1,VISIT);
+        }
+        undo_to(INNER);
+        std::swap(W[I],W[J]);
+      }
+    }
+    undo_to(MARK);
+  }
+
+  size_t N;
+  size_t L;
+  std::vector<size_t> CLASS; //dense class of each source index
+  std::vector<size_t> W;     //source index at each position
+  std::vector<size_t> NEXT;  //smallest source still allowed, per class
+  std::vector<std::pair<size_t,size_t>> UNDO;
+  std::vector<index_permutation> PLIST;
+};
+
+/*
+  the level L lists of N = CLASSES.size() indices giving distinct 
+  outputs. Class ids are any size_t labels, equal labels meaning equal
+  elements; they need not be dense or < N
+*/
+inline size_t num_distinct_unique_permutations(const std::vector<size_t>& CLASSES, const size_t L) {
+  size_t COUNT = 0;
+  distinct_permutation_walk(CLASSES,L).run([&COUNT](const index_permutation*) {COUNT++;});
+  return COUNT;
+}
+
+template<typename IDX = size_t>
+index_permutation_table<IDX> get_distinct_unique_permutations(const std::vector<size_t>& CLASSES,
+                                                              const size_t L) {
+  index_permutation_table<IDX> OUT(CLASSES.size(),L,num_distinct_unique_permutations(CLASSES,L));
+
+  basic_index_permutation<IDX>* ELEMENT = OUT.data();
+  distinct_permutation_walk(CLASSES,L).run([&ELEMENT,L](const index_permutation* PLIST) {
+    for (size_t X=0; X < L; X++) {
+      *ELEMENT++ = {static_cast<IDX>(PLIST[X].first),static_cast<IDX>(PLIST[X].second)};
+    }
+  });
+  return OUT;
+}
+
+
+/*
+  Work-stealing parallel apply
+
+  Per-list cost is often uneven (heavy T, early exit visitors), so a 
+  static split of the table leaves threads idle. Here every worker owns
+  a contiguous rank range behind its own mutex and takes GRAIN ranks at
+  a time from the front; a worker that runs dry steals the back half of
+  the largest remaining range. Ranges only shrink, so once a full scan
+  finds nothing to steal all work has been handed out.
+
+  FUNC is called concurrently but only ever on disjoint ranks. Writing 
+  results to slot K of a preallocated output keeps them in rank order
+  for any NTHREADS (0 uses std::thread::hardware_concurrency).
+*/
+struct alignas(64) work_stealing_range {
+  std::mutex LOCK;
+  size_t BEGIN;
+  size_t END;
+};
+
+//calls FUNC(BEGIN,END) on disjoint chunks covering 0..COUNT-1
+template<typename Function>
+void parallel_for_ranks(const size_t COUNT, Function&& FUNC, unsigned NTHREADS = 0,
+                        size_t GRAIN = 0) {
+  if (NTHREADS == 0) {
+    NTHREADS = std::max(1u,std::thread::hardware_concurrency());
+  }
+  NTHREADS = static_cast<unsigned>(std::max<size_t>(1,std::min<size_t>(NTHREADS,COUNT)));
+  if (GRAIN == 0) {
+    GRAIN = std::min<size_t>(1024,std::max<size_t>(1,COUNT / (NTHREADS*size_t(256))));
+  }
+  if (NTHREADS <= 1) {
+    for (size_t BEGIN=0; BEGIN < COUNT; BEGIN += GRAIN) {
+      FUNC(BEGIN,std::min(BEGIN + GRAIN,COUNT));
+    }
+    return;
+  }
+
+  std::vector<work_stealing_range> RANGES(NTHREADS);
+  for (unsigned T=0; T < NTHREADS; T++) {
+    RANGES[T].BEGIN = COUNT * T / NTHREADS;
+    RANGES[T].END = COUNT * (T + 1) / NTHREADS;
+  }
+
+  auto WORKER = [&RANGES,&FUNC,NTHREADS,GRAIN](const unsigned SELF) {
+    work_stealing_range& OWN = RANGES[SELF];
+    for (;;) {
+      size_t BEGIN = 0;
+      size_t END = 0;
+      {
+        std::lock_guard<std::mutex> GUARD(OWN.LOCK);
+        if (OWN.BEGIN < OWN.END) {
+          BEGIN = OWN.BEGIN;
+          END = std::min(BEGIN + GRAIN,OWN.END);
+          OWN.BEGIN = END;
+        }
+      }
+      if (BEGIN < END) {
+        FUNC(BEGIN,END);
+        continue;
+      }
+
+      //steal the back half of the largest range left
+      unsigned VICTIM = SELF;
+      size_t LARGEST = 0;
+      for (unsigned T=0; T < NTHREADS; T++) {
+        std::lock_guard<std::mutex> GUARD(RANGES[T].LOCK);
+        if (RANGES[T].END - RANGES[T].BEGIN > LARGEST) {
+          LARGEST = RANGES[T].END - RANGES[T].BEGIN;
+          VICTIM = T;
+        }
+      }
+      if (LARGEST == 0) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> GUARD(RANGES[VICTIM].LOCK);
+        work_stealing_range& R = RANGES[VICTIM];
+        if (R.BEGIN >= R.END) {
+          continue;
+        }
+        BEGIN = R.BEGIN + (R.END - R.BEGIN) / 2;
+        END = R.END;
+        R.END = BEGIN;
+      }
+      std::lock_guard<std::mutex> GUARD(OWN.LOCK);
+      OWN.BEGIN = BEGIN;
+      OWN.END = END;
+    }
+  };
+
+  std::vector<std::thread> WORKERS;
+  WORKERS.reserve(NTHREADS - 1);
+  for (unsigned T=1; T < NTHREADS; T++) {
+    WORKERS.emplace_back(WORKER,T);
+  }
+  WORKER(0);
+  for (auto& worker : WORKERS) {
+    worker.join();
+  }
+}
+
+//calls FUNC(K, TABLE[K]) for every list of a random access TABLE
+template<typename Table, typename Function>
+void parallel_for_each_permutation(const Table& TABLE, Function&& FUNC, const unsigned NTHREADS = 0,
+                                   const size_t GRAIN = 0) {
+  parallel_for_ranks(TABLE.size(),[&TABLE,&FUNC](const size_t BEGIN, const size_t END) {
+    for (size_t K=BEGIN; K < END; K++) {
+      FUNC(K,TABLE[K]);
+    }
+  },NTHREADS,GRAIN);
+}
+
+//as above over the level L lists of N indices, generated per chunk from its unranked start
+template<int N, int L, typename IDX = size_t, typename Function>
+void parallel_for_each_permutation(Function&& FUNC, const unsigned NTHREADS = 0,
+                                   const size_t GRAIN = 0) {
+  parallel_for_ranks(num_unique_permutations(N,L),[&FUNC](const size_t BEGIN, const size_t END) {
+    index_permutation_list<L,IDX> PLIST = unrank_unique_permutation<N,L,IDX>(BEGIN);
+    for (size_t K=BEGIN; K < END; K++) {
+      FUNC(K,static_cast<const index_permutation_list<L,IDX>&>(PLIST));
+      next_unique_permutation<N,L>(PLIST);
+    }
+  },NTHREADS,GRAIN);
+}
+
+//OUT[K] = IN with list K of TABLE applied, OUT holding at least TABLE.size() entries
+template<typename Table, class T, typename Output>
+void parallel_execute_permutations(const Table& TABLE, const T& IN, Output& OUT,
+                                   const unsigned NTHREADS = 0, const size_t GRAIN = 0) {
+  parallel_for_each_permutation(TABLE,[&IN,&OUT](const size_t K, const typename std::decay<decltype(TABLE[0])>::type& PLIST) {
+    UPERM_STATS_ADD(COPIES,IN.size(),PLIST.size(),1);
+    T PERMUTED = IN;
+    execute_permutations_inplace(PLIST,PERMUTED);
+    OUT[K] = std::move(PERMUTED);
+  },NTHREADS,GRAIN);
+}
+
+
+/*
+  Distributed partitioning
+
+  Each of NRANKS processes (e.g. MPI ranks) owns one contiguous range 
+  of the level L sequence and generates only that, resuming from the
+  unranked start of its range:
+
+    const uperm::rank_range R = uperm::partition_unique_permutations<N,L>(RANK,NRANKS);
+    for (auto const& PLIST : uperm::unique_permutation_range<N,L>(R.begin,R.end)) {...}
+
+  Every process computes the same split from the same inputs, so no
+  communication is needed.
+*/
+struct rank_range {
+  size_t begin;
+  size_t end;
+
+  size_t size() const {return end - begin;}
+};
+
+//the RANK-th of NRANKS ranges of 0..COUNT-1, sizes differ by at most one (empty if RANK >= NRANKS)
+inline rank_range partition_ranks(const size_t COUNT, const size_t RANK, const size_t NRANKS) {
+  if (RANK >= NRANKS) {
+    return {COUNT, COUNT};
+  }
+  const size_t BASE = COUNT / NRANKS;
+  const size_t EXTRA = COUNT % NRANKS;
+  const size_t BEGIN = RANK*BASE + std::min(RANK,EXTRA);
+  return {BEGIN, BEGIN + BASE + (RANK < EXTRA ? 1 : 0)};
+}
+
+template<int N, int L>
+rank_range partition_unique_permutations(const size_t RANK, const size_t NRANKS) {
+  return partition_ranks(num_unique_permutations(N,L),RANK,NRANKS);
+}
+
+/*
+  as above, balancing the total of per item costs WEIGHTS instead of
+  the item count: range R ends at the first item whose prefix sum 
+  reaches (R+1)/NRANKS of the total. The items are usually coarse 
+  blocks of the sequence, see partition_unique_permutations_weighted
+*/
+inline rank_range partition_ranks_weighted(const std::vector<double>& WEIGHTS, const size_t RANK,
+                                           const size_t NRANKS) {
+  if (RANK >= NRANKS) {
+    return {WEIGHTS.size(), WEIGHTS.size()};
+  }
+
+  std::vector<double> PREFIX(WEIGHTS.size());
+  double TOTAL = 0;
+  for (size_t K=0; K < WEIGHTS.size(); K++) {
+    TOTAL += WEIGHTS[K];
+    PREFIX[K] = TOTAL;
+  }
+
+  //first entry K with PREFIX[K] >= TARGET, the boundary is after it
+  auto BOUNDARY = [&PREFIX,TOTAL,NRANKS](const size_t R) -> size_t {
+    if (R == 0) {
+      return 0;
+    } else if (R >= NRANKS) {
+      return PREFIX.size();
+    }
+    const double TARGET = TOTAL * static_cast<double>(R) / static_cast<double>(NRANKS);
+    return static_cast<size_t>(std::lower_bound(PREFIX.begin(),PREFIX.end(),TARGET) - PREFIX.begin()) + 1;
+  };
+
+  const size_t BEGIN = std::min(BOUNDARY(RANK),PREFIX.size());
+  const size_t END = std::min(BOUNDARY(RANK + 1),PREFIX.size());
+  return {BEGIN, std::max(BEGIN,END)};
+}
+
+//depth X of for_each_unique_permutation_block, BEGIN is the rank of the first list below
+template<typename Visitor>
+void unique_permutation_blocks_loop(const size_t N, const size_t L, const size_t DEPTH, const size_t X,
+                                    const size_t MIN, size_t BEGIN, const size_t SIZE, Visitor& VISIT) {
+  if (X == DEPTH) {
+    VISIT(rank_range{BEGIN, BEGIN + SIZE});
+    return;
+  }
+  for (size_t I=MIN; I < N - L + X; I++) {
+    const size_t SUB = num_unique_permutations_ge_min(N,L-X-1,I);
+    for (size_t J=I+1; J < N; J++) {
+      unique_permutation_blocks_loop(N,L,DEPTH,X+1,I+1,BEGIN,SUB,VISIT);
+      BEGIN += SUB;
+    }
+  }
+}
+
+/*
+  calls VISIT(const rank_range&) for the blocks of the level L sequence
+  whose lists share their first DEPTH swaps (at most L), in rank order.
+  The blocks tile 0..num_unique_permutations(N,L)-1 and their sizes 
+  come from the counts, nothing is generated. There are at most 
+  (N*(N-1)/2)^DEPTH of them, e.g. 8281 for N=14 and DEPTH=2
+*/
+template<typename Visitor>
+void for_each_unique_permutation_block(const size_t N, const size_t L, size_t DEPTH, Visitor&& VISIT) {
+  if (L >= N && L > 0) {
+    return;
+  }
+  DEPTH = std::min(DEPTH,L);
+  unique_permutation_blocks_loop(N,L,DEPTH,0,0,0,num_unique_permutations(N,L),VISIT);
+}
+
+/*
+  the RANK-th of NRANKS ranges of the level L sequence balanced by cost:
+  WEIGHT(const rank_range&) returns the cost of one block of 
+  for_each_unique_permutation_block (the lists sharing their first DEPTH
+  swaps, unrank_unique_permutation of its begin gives the prefix), and
+  the ranges are cut between blocks with partition_ranks_weighted. Only
+  the per block weights are stored, never a per list table, so every 
+  process can compute the split for levels far too large to generate.
+  Deeper blocks balance more finely, at the cost of more WEIGHT calls
+*/
+template<int N, int L, typename Weight>
+rank_range partition_unique_permutations_weighted(Weight&& WEIGHT, const size_t RANK, const size_t NRANKS,
+                                                  const size_t DEPTH = 2) {
+  std::vector<rank_range> BLOCKS;
+  std::vector<double> WEIGHTS;
+  for_each_unique_permutation_block(N,L,DEPTH,[&BLOCKS,&WEIGHTS,&WEIGHT](const rank_range& B) {
+    BLOCKS.push_back(B);
+    WEIGHTS.push_back(static_cast<double>(WEIGHT(B)));
+  });
+
+  const rank_range R = partition_ranks_weighted(WEIGHTS,RANK,NRANKS);
+  const size_t COUNT = num_unique_permutations(N,L);
+  if (R.size() == 0) {
+    const size_t AT = (R.begin < BLOCKS.size()) ? BLOCKS[R.begin].begin : COUNT;
+    return {AT, AT};
+  }
+  return {BLOCKS[R.begin].begin, BLOCKS[R.end-1].end};
+}
+
+//the lists of ranks R.begin..R.end-1 only
+template<int N, int L, typename IDX = size_t>
+index_permutation_list_vector<N,L,IDX> get_unique_permutations_range(const rank_range& R) {
+  index_permutation_list_vector<N,L,IDX> OUT(R.size());
+  fill_unique_permutations<N,L,IDX>(R.begin,R.size(),OUT.begin());
+  return OUT;
+}
+
+#ifdef UPERM_ENABLE_MPI
+//the range of the calling process of COMM
+template<int N, int L>
+rank_range partition_unique_permutations(MPI_Comm COMM) {
+  int RANK = 0;
+  int NRANKS = 1;
+  MPI_Comm_rank(COMM,&RANK);
+  MPI_Comm_size(COMM,&NRANKS);
+  return partition_unique_permutations<N,L>(static_cast<size_t>(RANK),static_cast<size_t>(NRANKS));
+}
+#endif
+
+
+/*
+  Cycle form
+
+  A level L list of swaps costs 3L moves when applied as swaps. Stored 
+  as the cycles of its composed index map instead, it is applied by 
+  cycle leader moves: one temporary per cycle and one move per moved
+  element, at most N + #cycles moves in total. Only moves are used, so
+  T may be move-only, and DATA is permuted in place without copying.
+
+  ELEMENTS holds the cycles of length >= 2 one after another, cycle C
+  being LENGTHS[C] entries long, in the order i, MAP[i], MAP[MAP[i]] ...
+  so that applying it gives DATA[i] = old DATA[MAP[i]], the same result
+  as execute_permutations. A level L list moves at most 2L elements 
+  and has at most L cycles.
+*/
+template<int N, int L>
+struct permutation_cycles {
+  static constexpr size_t MAX_ELEMENTS = (2*L < N) ? 2*L : N;
+  static constexpr size_t MAX_CYCLES = (L > 0) ? L : 1;
+
+  uint8_t NELEMENTS;
+  uint8_t NCYCLES;
+  std::array<uint8_t,MAX_ELEMENTS> ELEMENTS;
+  std::array<uint8_t,MAX_CYCLES> LENGTHS;
+};
+
+template<int N, int L>
+using permutation_cycles_vector = std::vector<permutation_cycles<N,L>>;
+
+//the cycles of the composed map of a level L list
+template<int N, int L, typename IDX = size_t>
+permutation_cycles<N,L> compose_permutation_cycles(const index_permutation_list<L,IDX>& PLIST) {
+  static_assert(N <= 256, "cycles store indices as uint8_t");
+  const index_map<N> MAP = compose_index_map<N,L,IDX>(PLIST);
+
+  permutation_cycles<N,L> OUT{};
+  std::array<bool,N> SEEN{};
+  for (size_t I=0; I < MAP.size(); I++) {
+    if (SEEN[I] || MAP[I] == I) {
+      continue;
+    }
+    size_t LENGTH = 0;
+    for (size_t X=I; !SEEN[X]; X=MAP[X]) {
+      SEEN[X] = true;
+      OUT.ELEMENTS[OUT.NELEMENTS++] = static_cast<uint8_t>(X);
+      LENGTH++;
+    }
+    OUT.LENGTHS[OUT.NCYCLES++] = static_cast<uint8_t>(LENGTH);
+  }
+  return OUT;
+}
+
+//the cycle forms of all level L lists of N indices, in sequence order
+template<int N, int L>
+permutation_cycles_vector<N,L> get_all_unique_permutation_cycles() {
+  permutation_cycles_vector<N,L> OUT;
+  OUT.reserve(num_unique_permutations(N,L));
+  for (auto const& PLIST : unique_permutation_range<N,L,uint8_t>()) {
+    OUT.push_back(compose_permutation_cycles<N,L>(PLIST));
+  }
+  return OUT;
+}
+
+//DATA[i] = old DATA[MAP[i]], by moves only
+template<class T, int N, int L>
+void execute_permutations_inplace(const permutation_cycles<N,L>& CYCLES, T& DATA) {
+  UPERM_STATS_ADD(SWAPS,N,L,CYCLES.NELEMENTS - CYCLES.NCYCLES);
+  auto BASE = DATA.begin();
+  size_t START = 0;
+  for (size_t C=0; C < CYCLES.NCYCLES; C++) {
+    const uint8_t* CYCLE = CYCLES.ELEMENTS.data() + START;
+    const size_t LENGTH = CYCLES.LENGTHS[C];
+    auto LEADER = std::move(*(BASE + CYCLE[0]));
+    for (size_t X=0; X+1 < LENGTH; X++) {
+      *(BASE + CYCLE[X]) = std::move(*(BASE + CYCLE[X+1]));
+    }
+    *(BASE + CYCLE[LENGTH-1]) = std::move(LEADER);
+    START += LENGTH;
+  }
+}
+
+//restores DATA after execute_permutations_inplace(CYCLES,DATA)
+template<class T, int N, int L>
+void undo_permutations_inplace(const permutation_cycles<N,L>& CYCLES, T& DATA) {
+  UPERM_STATS_ADD(SWAPS,N,L,CYCLES.NELEMENTS - CYCLES.NCYCLES);
+  auto BASE = DATA.begin();
+  size_t START = 0;
+  for (size_t C=0; C < CYCLES.NCYCLES; C++) {
+    const uint8_t* CYCLE = CYCLES.ELEMENTS.data() + START;
+    const size_t LENGTH = CYCLES.LENGTHS[C];
+    auto LAST = std::move(*(BASE + CYCLE[LENGTH-1]));
+    for (size_t X=LENGTH-1; X > 0; X--) {
+      *(BASE + CYCLE[X]) = std::move(*(BASE + CYCLE[X-1]));
+    }
+    *(BASE + CYCLE[0]) = std::move(LAST);
+    START += LENGTH;
+  }
+}
+
+
+/*
+  Prefix cache
+
+  Lists next to each other in the level sequence share leading swaps,
+  e.g. P(1,2)P(0,1) and P(1,3)P(0,1) both start with P(0,1). The cache
+  analyzes a table once and keeps, for every distinct prefix of the
+  first DEPTH swaps, the input with that prefix applied. DEPTH is the 
+  deepest one whose slots fit in MEMORY_CAP bytes (SLOT_BYTES each, 
+  sizeof(T) by default; pass the real size for heap backed T). If none
+  fits, DEPTH is 0 and the single slot is the input itself.
+
+  Each new input costs one pass over the slots in set_input, after 
+  which a list only applies its last L-DEPTH swaps. The analysis and 
+  the slot storage are reused by every later set_input.
+
+    uperm::permutation_prefix_cache<std::array<double,N>> CACHE(TABLE,1 << 20);
+    for (auto const& IN : INPUTS) {
+      CACHE.set_input(IN);
+      CACHE.for_each([](size_t K, const std::array<double,N>& PERMUTED) {...});
+    }
+*/
+template<class T, typename IDX = size_t>
+class permutation_prefix_cache {
+public:
+  template<typename Table>
+  permutation_prefix_cache(const Table& TABLE, const size_t MEMORY_CAP,
+                           const size_t SLOT_BYTES = sizeof(T)) 
+    : L(0), COUNT(0), DEPTH(0), SLOT_BYTES(SLOT_BYTES) {
+    for (auto const& PLIST : TABLE) {
+      L = PLIST.size();
+      for (auto const& perm : PLIST) {
+        SWAPS.push_back({static_cast<IDX>(perm.first),static_cast<IDX>(perm.second)});
+      }
+      COUNT++;
+    }
+
+    //RUNS[D] = number of distinct consecutive prefixes of D swaps
+    std::vector<size_t> RUNS(L + 1,COUNT > 0 ? 1 : 0);
+    for (size_t K=1; K < COUNT; K++) {
+      const size_t P = first_difference(K-1,K);
+      for (size_t D=P+1; D <= L; D++) {
+        RUNS[D]++;
+      }
+    }
+    for (size_t D=L; D > 0; D--) {
+      if (RUNS[D] * SLOT_BYTES <= MEMORY_CAP) {
+        DEPTH = D;
+        break;
+      }
+    }
+
+    SLOT.resize(COUNT);
+    for (size_t K=0; K < COUNT; K++) {
+      if (K == 0 || first_difference(K-1,K) < DEPTH) {
+        SLOT_ENTRY.push_back(K);
+      }
+      SLOT[K] = SLOT_ENTRY.size() - 1;
+    }
+  }
+
+  //applies every cached prefix to IN
+  void set_input(const T& IN) {
+    UPERM_STATS_ADD(COPIES,IN.size(),L,SLOT_ENTRY.size());
+    SLOTS.resize(SLOT_ENTRY.size(),IN);
+    for (size_t S=0; S < SLOT_ENTRY.size(); S++) {
+      SLOTS[S] = IN;
+      execute_permutations_inplace(prefix(SLOT_ENTRY[S]),SLOTS[S]);
+    }
+  }
+
+  //list K applied to the current input
+  T execute(const size_t K) const {
+    UPERM_STATS_ADD(COPIES,SLOTS[SLOT[K]].size(),L,1);
+    T OUT = SLOTS[SLOT[K]];
+    execute_permutations_inplace(suffix(K),OUT);
+    return OUT;
+  }
+
+  /*
+    calls VISIT(K, PERMUTED) for every list K in order. Lists of the same
+    slot undo the previous suffix instead of copying the slot again
+  */
+  template<typename Visitor>
+  void for_each(Visitor&& VISIT) {
+    for (size_t K=0; K < COUNT; K++) {
+      if (K == 0 || SLOT[K] != SLOT[K-1]) {
+        UPERM_STATS_ADD(COPIES,SLOTS[SLOT[K]].size(),L,1);
+        WORK = SLOTS[SLOT[K]];
+      } else {
+        undo_permutations_inplace(suffix(K-1),WORK);
+      }
+      execute_permutations_inplace(suffix(K),WORK);
+      VISIT(K,static_cast<const T&>(WORK));
+    }
+  }
+
+  size_t size() const {return COUNT;}
+  size_t level() const {return L;}
+  size_t depth() const {return DEPTH;}
+  size_t num_slots() const {return SLOT_ENTRY.size();}
+  size_t memory_bytes() const {return SLOT_ENTRY.size() * SLOT_BYTES;}
+
+private:
+  //first swap position where lists A and B differ, L if they are equal
+  size_t first_difference(const size_t A, const size_t B) const {
+    for (size_t X=0; X < L; X++) {
+      const basic_index_permutation<IDX>& PA = SWAPS[A*L + X];
+      const basic_index_permutation<IDX>& PB = SWAPS[B*L + X];
+      if (PA.first != PB.first || PA.second != PB.second) {
+        return X;
+      }
+    }
+    return L;
+  }
+
+  index_permutation_span<IDX> prefix(const size_t K) const {return {SWAPS.data() + K*L, DEPTH, L};}
+  index_permutation_span<IDX> suffix(const size_t K) const {return {SWAPS.data() + K*L + DEPTH, L - DEPTH, L};}
+
+  size_t L;
+  size_t COUNT;
+  size_t DEPTH;
+  size_t SLOT_BYTES;
+  std::vector<basic_index_permutation<IDX>> SWAPS;
+  std::vector<size_t> SLOT;        //slot of each list
+  std::vector<size_t> SLOT_ENTRY;  //first list of each slot
+  std::vector<T> SLOTS;
+  T WORK;
+};
+
+
+#if __cplusplus >= 201703L
+/*
+  Compile-time unrolled apply (C++17)
+
+  For fixed N and L the composed map of every entry of 
+  unique_permutation_table<N,L> is a constant, so applying entry K is a
+  single index_sequence gather, OUT = {IN[MAP[0]], ..., IN[MAP[N-1]]},
+  with no loop, no table load and no index arithmetic at run time. For
+  small N the whole array stays in registers. Every entry is its own 
+  instantiation, so this is meant for small levels (a few hundred lists)
+*/
+template<int N, int L, size_t K>
+inline constexpr index_map<N> static_index_map = 
+  compose_index_map<N,L>(unique_permutation_table<N,L,uint8_t>[K]);
+
+template<int N, int L, size_t K, class T, size_t... IS>
+constexpr std::array<T,N> execute_permutations_static(const std::array<T,N>& IN, std::index_sequence<IS...>) {
+  return {{IN[static_index_map<N,L,K>[IS]]...}};
+}
+
+//entry K of the level L table applied to IN, equal to execute_permutations
+template<int N, int L, size_t K, class T>
+constexpr std::array<T,N> execute_permutations_static(const std::array<T,N>& IN) {
+  static_assert(K < num_unique_permutations(N,L), "K is past the end of the level");
+  return execute_permutations_static<N,L,K>(IN,std::make_index_sequence<N>());
+}
+
+template<int N, int L, class T, typename Visitor, size_t... KS>
+void apply_all_permutations_static(const std::array<T,N>& IN, Visitor& VISIT, std::index_sequence<KS...>) {
+  (VISIT(static_cast<const std::array<T,N>&>(execute_permutations_static<N,L,KS>(IN)),
+         unique_permutation_table<N,L>[KS]), ...);
+}
+
+/*
+  calls VISIT(PERMUTED, PLIST) for every entry of the level L table, in
+  order, like apply_all_permutations but fully unrolled. PLIST is the
+  entry of unique_permutation_table<N,L>, an index_permutation_list<L>,
+  so the same visitors work with both
+*/
+template<int N, int L, class T, typename Visitor>
+void apply_all_permutations_static(const std::array<T,N>& IN, Visitor&& VISIT) {
+  UPERM_STATS_ADD(COPIES,N,L,num_unique_permutations(N,L));
+  apply_all_permutations_static<N,L>(IN,VISIT,std::make_index_sequence<num_unique_permutations(N,L)>());
+}
+#endif
+
+
+} //end of namespace
+
+#endif //UPERM_H
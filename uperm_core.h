@@ -0,0 +1,435 @@
+/*  uperm_core.h
+
+  The std::vector free core of uperm: the index permutation types, the
+  counts, and the raw pointer first/next/rank/unrank routines. Every 
+  function is UPERM_HOST_DEVICE, so a GPU kernel can give each thread
+  one rank K and rebuild its level L list in registers,
+
+    __global__ void kernel(size_t COUNT, ...) {
+      const size_t K = blockIdx.x * blockDim.x + threadIdx.x;
+      if (K >= COUNT) return;
+      uperm::basic_index_permutation<uint8_t> PLIST[L];
+      uperm::unrank_unique_permutation(N,L,K,PLIST);
+      ...
+    }
+
+  instead of reading a table from global memory. Device code should use
+  the raw pointer forms: std::array members are only callable there with
+  relaxed constexpr (nvcc --expt-relaxed-constexpr). 
+
+  Device passes cannot read the host lookup table, so each count there 
+  is an O(N*L) recurrence and an unrank without a table costs 
+  O(N*L^2*log N). Kernels should build the (N+1)*(L+1) counts once per
+  block in shared memory and pass them to the COUNTS overloads:
+
+    __shared__ size_t COUNTS[(NMAX+1)*(LMAX+1)];
+    if (threadIdx.x == 0) uperm::fill_unique_permutation_counts(N,L,COUNTS);
+    __syncthreads();
+    uperm::unrank_unique_permutation(N,L,K,PLIST,COUNTS);
+
+  which makes every count one shared memory load.
+
+  uperm.h includes this header, host code needs nothing else.
+*/
+
+#ifndef UPERM_CORE_H
+#define UPERM_CORE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+//std::array is only mutable in constant expressions from C++17 onward
+#if __cplusplus >= 201703L
+#define UPERM_CONSTEXPR17 constexpr
+#else
+#define UPERM_CONSTEXPR17
+#endif
+
+/*
+  host/device annotation for the functions of this header, so CUDA and
+  HIP kernels can call them (SYCL kernels need none)
+*/
+#if defined(__CUDACC__) || defined(__HIPCC__)
+#define UPERM_HOST_DEVICE __host__ __device__
+#else
+#define UPERM_HOST_DEVICE
+#endif
+
+//device passes cannot read the host count table, they use the recurrence
+#if defined(__CUDA_ARCH__) || defined(__HIP_DEVICE_COMPILE__)
+#define UPERM_DEVICE_COMPILE 1
+#endif
+
+namespace uperm {
+
+//contains the indices to permute, starting from zero
+template<typename IDX>
+struct basic_index_permutation {
+  IDX first;
+  IDX second;
+  
+};
+
+//default, size_t indices
+using index_permutation = basic_index_permutation<size_t>;
+
+/*
+  smallest unsigned type holding indices 0..N-1. Tables built with it
+  are up to 8x smaller than with the default size_t, e.g.
+    uperm::get_all_unique_permutations<N,L,uperm::compact_index_t<N>>()
+*/
+template<int N>
+using compact_index_t = typename std::conditional<(N <= 256), uint8_t,
+                        typename std::conditional<(N <= 65536), uint16_t, uint32_t>::type>::type;
+
+//alias for array of indices to permute
+template<int L, typename IDX = size_t> //L is level or # of permutations
+using index_permutation_list = std::array<basic_index_permutation<IDX>,L>;
+
+
+//Number of pairs for a given total elements (N) and minimum 
+// LHS index MIN
+UPERM_HOST_DEVICE constexpr size_t num_unique_pairs_ge_min(const size_t N, 
+                                                           const size_t MIN) {
+  return (N-MIN > 0 && MIN <= N-2) ? (N-MIN)*(N-MIN-1)/2 : 0;
+}
+
+//Number of pairs for a given total elements (N) 
+UPERM_HOST_DEVICE constexpr size_t num_unique_pairs(const size_t N) {
+  return ( N > 0 ) ? (N)*(N-1)/2 : 0;
+}
+
+//Number of pairs (N) with maximum LHS index (MAX)
+UPERM_HOST_DEVICE constexpr size_t num_unique_pairs_lt_max(const size_t N,
+                                                           const size_t MAX) {
+  return ( N > 0 && MAX >= 0) ? (2*N*MAX - MAX*MAX - MAX)/2 : 0; 
+}
+
+/*
+  Counting
+
+  The number of level L lists of N indices is the number of 
+  permutations of N elements with N-L cycles, the unsigned Stirling 
+  number of the first kind c(N,N-L). Writing u(N,L) = c(N,N-L), 
+  element N-1 is either a fixed point or follows one of the other N-1
+  elements in its cycle, so
+
+    u(N,L) = u(N-1,L) + (N-1)*u(N-1,L-1),   u(N,0) = 1, u(N,L>=N) = 0
+
+  which is evaluated as a rolling O(N*L) row instead of the exponential
+  recursion over LHS indices. Since u(N,L) >= L!, any L above 34 
+  overflows even 128 bits, so rows never need more than 
+  UPERM_MAX_COUNT_LEVEL entries.
+*/
+#define UPERM_MAX_COUNT_LEVEL 64
+
+/*
+  u(N,L) in UINT. Returns false if it does not fit, OUT is then
+  unspecified. Only the entries of each row that feed u(N,L) are 
+  updated, each of them is <= u(N,L), so an overflow in the row is an
+  overflow of the result
+*/
+template<typename UINT>
+UPERM_HOST_DEVICE constexpr bool num_unique_permutations_dp(const size_t N, const size_t L, UINT& OUT) {
+  OUT = 0;
+  if (L == 0) {
+    OUT = 1;
+    return true;
+  } else if (N == 0 || L > N - 1) {
+    return true;
+  } else if (L >= UPERM_MAX_COUNT_LEVEL) {
+    return false;
+  }
+
+  const UINT MAX = static_cast<UINT>(~UINT(0));
+  UINT ROW[UPERM_MAX_COUNT_LEVEL] = {};
+  ROW[0] = 1;
+  for (size_t n=2; n <= N; n++) {
+    const size_t RMIN = (L + n > N + 1) ? L + n - N : 1;
+    const size_t RMAX = (L < n-1) ? L : n-1;
+    for (size_t r=RMAX; r >= RMIN; r--) {
+      const UINT M = static_cast<UINT>(n - 1);
+      if (ROW[r-1] > MAX / M) {
+        return false;
+      }
+      const UINT ADD = M * ROW[r-1];
+      if (ROW[r] > MAX - ADD) {
+        return false;
+      }
+      ROW[r] += ADD;
+    }
+  }
+
+  OUT = ROW[L];
+  return true;
+}
+
+/*
+  Lookup table of u(n,r) for n,r < UPERM_MAX_COUNT_LEVEL, saturated at
+  SIZE_MAX. Built at compile time (32 KB of .rodata), it makes the 
+  counts used by rank/unrank O(1)
+*/
+struct unique_permutation_count_table {
+  size_t COUNT[UPERM_MAX_COUNT_LEVEL][UPERM_MAX_COUNT_LEVEL];
+
+  constexpr unique_permutation_count_table() : COUNT{} {
+    const size_t MAX = static_cast<size_t>(-1);
+    for (size_t n=0; n < UPERM_MAX_COUNT_LEVEL; n++) {
+      COUNT[n][0] = 1;
+      for (size_t r=1; r < n; r++) {
+        const size_t A = COUNT[n-1][r];
+        const size_t B = COUNT[n-1][r-1];
+        const size_t ADD = (B > MAX / (n-1)) ? MAX : (n-1) * B;
+        COUNT[n][r] = (A > MAX - ADD) ? MAX : A + ADD;
+      }
+    }
+  }
+};
+
+template<typename D = void>
+struct unique_permutation_counts {
+  static constexpr unique_permutation_count_table TABLE{};
+};
+template<typename D>
+constexpr unique_permutation_count_table unique_permutation_counts<D>::TABLE;
+
+
+/* Number of unique permutations of N elements generated from 
+ level L (number of allowed pair swaps). Saturates at SIZE_MAX when 
+ the count does not fit, see num_unique_permutations_checked */ 
+UPERM_HOST_DEVICE constexpr size_t num_unique_permutations(const size_t N, 
+                                                           const size_t L) {
+#ifndef UPERM_DEVICE_COMPILE
+  if (N < UPERM_MAX_COUNT_LEVEL && L < UPERM_MAX_COUNT_LEVEL) {
+    return unique_permutation_counts<>::TABLE.COUNT[N][L];
+  }
+#endif
+
+  size_t total = 0;
+  return num_unique_permutations_dp(N,L,total) ? total : static_cast<size_t>(-1);
+} 
+
+/*Number of unique permutations of N elements generated from 
+    level L, with LHS index >= MIN. These are the lists of the 
+    N-MIN-1 indices after MIN */
+UPERM_HOST_DEVICE constexpr size_t num_unique_permutations_ge_min(const size_t N,
+                                                                  const size_t L,
+                                                                  const size_t MIN) {
+  if (L==0) {
+    return 1;
+  } else if (MIN + 2 > N) {
+    return 0;
+  }
+
+  return num_unique_permutations(N - MIN - 1,L);
+}
+
+/* overflow checked counts, returns false if u(N,L) does not fit in 
+ OUT */
+UPERM_HOST_DEVICE constexpr bool num_unique_permutations_checked(const size_t N, const size_t L,
+                                                                 size_t& OUT) {
+  return num_unique_permutations_dp(N,L,OUT);
+}
+
+#ifdef __SIZEOF_INT128__
+//128 bit counts, exact up to u(N,L) < 2^128
+UPERM_HOST_DEVICE constexpr bool num_unique_permutations_checked(const size_t N, const size_t L,
+                                                                 unsigned __int128& OUT) {
+  return num_unique_permutations_dp(N,L,OUT);
+}
+#endif
+
+
+/*
+  sets the L swaps at PLIST to the first level L permutation list, 
+  P(0,1) P(1,2) ... P(L-1,L)
+*/
+template<typename IDX>
+UPERM_HOST_DEVICE UPERM_CONSTEXPR17 void first_unique_permutation(const int L, basic_index_permutation<IDX>* PLIST) {
+  for (int X=0; X < L; X++) {
+    PLIST[X] = {static_cast<IDX>(X),static_cast<IDX>(X+1)};
+  }
+}
+
+/*
+  advances the L swaps at PLIST to the next level L permutation list of
+  N indices, in the same order that get_all_unique_permutations emits them. 
+
+  Works like std::next_permutation: returns false and resets PLIST to
+  the first list once the last list has been passed. 
+
+  Position X may use LHS indices up to N-L+X-1, so that the remaining
+  L-X-1 swaps still have room for strictly increasing LHS indices
+*/
+template<typename IDX>
+UPERM_HOST_DEVICE UPERM_CONSTEXPR17 bool next_unique_permutation(const int N, const int L, 
+                                                                 basic_index_permutation<IDX>* PLIST) {
+  for (int X=L-1; X >= 0; X--) {
+    auto& perm = PLIST[X];
+    if (static_cast<size_t>(perm.second) + 1 < static_cast<size_t>(N)) {
+      perm.second++;
+    } else if (static_cast<size_t>(perm.first) + 1 < static_cast<size_t>(N - L + X)) {
+      perm.first++;
+      perm.second = static_cast<IDX>(perm.first + 1);
+    } else {
+      continue;
+    }
+    
+    //reset the tail to the smallest lists allowed after X
+    for (int Y=X+1; Y < L; Y++) {
+      PLIST[Y] = {static_cast<IDX>(PLIST[Y-1].first+1),static_cast<IDX>(PLIST[Y-1].first+2)};
+    }
+    return true;
+  }
+
+  first_unique_permutation(L,PLIST);
+  return false;
+}
+
+
+/*
+  writes u(n,r) for n <= N and r <= L to COUNTS[n*(L+1) + r], saturated
+  at SIZE_MAX like the host table, in O(N*L). These are all the counts
+  rank and unrank of (N,L) read
+*/
+UPERM_HOST_DEVICE inline void fill_unique_permutation_counts(const size_t N, const size_t L, size_t* COUNTS) {
+  const size_t MAX = static_cast<size_t>(-1);
+  const size_t STRIDE = L + 1;
+  for (size_t n=0; n <= N; n++) {
+    COUNTS[n*STRIDE] = 1;
+    for (size_t r=1; r <= L; r++) {
+      size_t C = 0;
+      if (r < n) {
+        const size_t A = COUNTS[(n-1)*STRIDE + r];
+        const size_t B = COUNTS[(n-1)*STRIDE + r-1];
+        const size_t ADD = (B > MAX / (n-1)) ? MAX : (n-1) * B;
+        C = (A > MAX - ADD) ? MAX : A + ADD;
+      }
+      COUNTS[n*STRIDE + r] = C;
+    }
+  }
+}
+
+//u(n,r) from num_unique_permutations, the host table or the device recurrence
+struct unique_permutation_count_lookup {
+  UPERM_HOST_DEVICE size_t operator()(const size_t n, const size_t r) const {
+    return num_unique_permutations(n,r);
+  }
+};
+
+//u(n,r) from a fill_unique_permutation_counts table
+struct unique_permutation_count_view {
+  const size_t* COUNTS;
+  size_t STRIDE;
+
+  UPERM_HOST_DEVICE size_t operator()(const size_t n, const size_t r) const {
+    return COUNTS[n*STRIDE + r];
+  }
+};
+
+/*
+  Rank and unrank for level L permutation lists of N indices.
+
+  The lists sharing swaps 0..X-1 form a contiguous block of the level L 
+  sequence. Within that block, swap X = (I,J) is followed by 
+  num_unique_permutations_ge_min(N,L-X-1,I) completions, so the K-th list
+  is found from the block sizes instead of generating the K-1 lists
+  before it. Since u(n,r+1) - u(n-1,r+1) = (n-1)*u(n-1,r), the blocks of
+  the LHS indices MIN..I-1 skipped at position X add up to
+
+    u(N-MIN,L-X) - u(N-I,L-X)
+
+  so rank costs O(L) count lookups, and unrank binary searches I in 
+  O(L log N).
+*/
+
+//unrank with the counts u(n,r) given by COUNT(n,r)
+template<typename IDX, typename Counts>
+UPERM_HOST_DEVICE void unrank_unique_permutation_counts(const size_t N, const size_t L, size_t K,
+                                                        basic_index_permutation<IDX>* PLIST,
+                                                        const Counts& COUNT) {
+  if (L >= N) {
+    return;
+  }
+
+  size_t MIN = 0;
+  for (size_t X=0; X < L; X++) {
+    const size_t R = L - X;
+    const size_t TOTAL = COUNT(N - MIN,R);
+
+    //largest LHS index I whose skipped blocks do not pass K
+    size_t LO = MIN;
+    size_t HI = N - L + X - 1;
+    while (LO < HI) {
+      const size_t MID = LO + (HI - LO + 1) / 2;
+      if (TOTAL - COUNT(N - MID,R) <= K) {
+        LO = MID;
+      } else {
+        HI = MID - 1;
+      }
+    }
+
+    //num_unique_permutations_ge_min(N,R-1,I), I <= N-2 here
+    const size_t I = LO;
+    K -= TOTAL - COUNT(N - I,R);
+    const size_t SUB = (R == 1) ? 1 : COUNT(N - I - 1,R - 1);
+    PLIST[X] = {static_cast<IDX>(I), static_cast<IDX>(I + 1 + K/SUB)};
+    K %= SUB;
+    MIN = I + 1;
+  }
+}
+
+//rank with the counts u(n,r) given by COUNT(n,r)
+template<typename IDX, typename Counts>
+UPERM_HOST_DEVICE size_t rank_unique_permutation_counts(const size_t N, const size_t L,
+                                                        const basic_index_permutation<IDX>* PLIST,
+                                                        const Counts& COUNT) {
+  size_t K = 0;
+
+  size_t MIN = 0;
+  for (size_t X=0; X < L; X++) {
+    const size_t I = PLIST[X].first;
+    const size_t J = PLIST[X].second;
+    K += COUNT(N - MIN,L-X) - COUNT(N - I,L-X);
+    K += (J - I - 1) * ((X + 1 == L) ? 1 : COUNT(N - I - 1,L-X-1));
+    MIN = I + 1;
+  }
+
+  return K;
+}
+
+//writes the K-th list (0 <= K < num_unique_permutations(N,L)) to the L swaps at PLIST
+template<typename IDX>
+UPERM_HOST_DEVICE void unrank_unique_permutation(const size_t N, const size_t L, const size_t K,
+                                                 basic_index_permutation<IDX>* PLIST) {
+  unrank_unique_permutation_counts(N,L,K,PLIST,unique_permutation_count_lookup());
+}
+
+//as above, reading the counts from a fill_unique_permutation_counts(N,L,COUNTS) table
+template<typename IDX>
+UPERM_HOST_DEVICE void unrank_unique_permutation(const size_t N, const size_t L, const size_t K,
+                                                 basic_index_permutation<IDX>* PLIST,
+                                                 const size_t* COUNTS) {
+  unrank_unique_permutation_counts(N,L,K,PLIST,unique_permutation_count_view{COUNTS,L + 1});
+}
+
+//returns the position K of the L swaps at PLIST in the level L sequence
+template<typename IDX>
+UPERM_HOST_DEVICE size_t rank_unique_permutation(const size_t N, const size_t L,
+                                                 const basic_index_permutation<IDX>* PLIST) {
+  return rank_unique_permutation_counts(N,L,PLIST,unique_permutation_count_lookup());
+}
+
+//as above, reading the counts from a fill_unique_permutation_counts(N,L,COUNTS) table
+template<typename IDX>
+UPERM_HOST_DEVICE size_t rank_unique_permutation(const size_t N, const size_t L,
+                                                 const basic_index_permutation<IDX>* PLIST,
+                                                 const size_t* COUNTS) {
+  return rank_unique_permutation_counts(N,L,PLIST,unique_permutation_count_view{COUNTS,L + 1});
+}
+
+} //end of namespace
+
+#endif //UPERM_CORE_H
@@ -0,0 +1,227 @@
+/*  uperm_mmap.h
+
+  On-disk format for precomputed permutation tables, and a loader that
+  maps a table read-only into memory instead of regenerating it. All
+  processes on a node mapping the same file share its page cache, so
+  e.g. thousands of MPI ranks pay for one copy of a N=14 table.
+
+  File layout (native byte order, checked on load):
+    permutation_table_header   64 bytes
+    padding                    up to DATA_OFFSET (a multiple of 64)
+    COUNT packed index_permutation_list<L,IDX> entries
+
+  Writing uses stdio and works anywhere, mapping requires POSIX mmap.
+
+    uperm::write_permutation_table<12>("n12l6.uperm",
+                                       uperm::get_all_unique_permutations<12,6,uint8_t>());
+
+    uperm::mapped_permutation_table<12,6,uint8_t> T;
+    if (T.open("n12l6.uperm")) {
+      for (const auto& PLIST : T) { ... }
+    }
+*/
+
+#ifndef UPERM_MMAP_H
+#define UPERM_MMAP_H
+
+#include "uperm.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UPERM_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace uperm {
+
+#define UPERM_TABLE_MAGIC "UPERMTBL"
+#define UPERM_TABLE_VERSION 1
+#define UPERM_TABLE_ALIGN 64
+
+//fixed 64 byte file header, all later versions keep the first 16 bytes
+struct permutation_table_header {
+  char     MAGIC[8];     //UPERM_TABLE_MAGIC, no terminator
+  uint32_t VERSION;
+  uint32_t ENDIAN_TAG;   //0x01020304 as written by the producer
+  uint32_t N;
+  uint32_t L;
+  uint32_t INDEX_WIDTH;  //sizeof(IDX)
+  uint32_t ENTRY_BYTES;  //sizeof(index_permutation_list<L,IDX>)
+  uint64_t COUNT;
+  uint64_t DATA_OFFSET;
+  uint8_t  RESERVED[16];
+};
+
+static_assert(sizeof(permutation_table_header) == 64, "header must stay 64 bytes");
+
+//header for a table of COUNT entries of type index_permutation_list<L,IDX>
+template<int N, int L, typename IDX>
+permutation_table_header make_permutation_table_header(const size_t COUNT) {
+  permutation_table_header H;
+  memset(&H,0,sizeof(H));
+  memcpy(H.MAGIC,UPERM_TABLE_MAGIC,sizeof(H.MAGIC));
+  H.VERSION = UPERM_TABLE_VERSION;
+  H.ENDIAN_TAG = 0x01020304;
+  H.N = N;
+  H.L = L;
+  H.INDEX_WIDTH = sizeof(IDX);
+  H.ENTRY_BYTES = sizeof(index_permutation_list<L,IDX>);
+  H.COUNT = COUNT;
+  H.DATA_OFFSET = (sizeof(H) + UPERM_TABLE_ALIGN - 1) / UPERM_TABLE_ALIGN * UPERM_TABLE_ALIGN;
+  return H;
+}
+
+//true if H describes a complete index_permutation_list<L,IDX> table of a file of FILE_BYTES
+template<int N, int L, typename IDX>
+bool check_permutation_table_header(const permutation_table_header& H, const size_t FILE_BYTES) {
+  if (FILE_BYTES < sizeof(H) || memcmp(H.MAGIC,UPERM_TABLE_MAGIC,sizeof(H.MAGIC)) != 0) {
+    return false;
+  }
+  if (H.VERSION != UPERM_TABLE_VERSION || H.ENDIAN_TAG != 0x01020304) {
+    return false;
+  }
+  if (H.N != N || H.L != L || H.INDEX_WIDTH != sizeof(IDX) ||
+      H.ENTRY_BYTES != sizeof(index_permutation_list<L,IDX>)) {
+    return false;
+  }
+  if (H.COUNT != num_unique_permutations(N,L) || H.DATA_OFFSET % UPERM_TABLE_ALIGN != 0) {
+    return false;
+  }
+  return H.DATA_OFFSET <= FILE_BYTES &&
+         H.COUNT <= (FILE_BYTES - H.DATA_OFFSET) / H.ENTRY_BYTES;
+}
+
+/*
+  writes the N index TABLE to PATH. Returns false on any I/O error, and
+  without creating the file if TABLE is not the whole level L table
+  (the only kind mapped_permutation_table accepts)
+*/
+template<int N, typename IDX, size_t L, typename Allocator>
+bool write_permutation_table(const char* PATH,
+                             const std::vector<std::array<basic_index_permutation<IDX>,L>,Allocator>& TABLE) {
+  static_assert(std::is_trivially_copyable<index_permutation_list<L,IDX>>::value,
+                "entries are written as raw bytes");
+  if (TABLE.size() != num_unique_permutations(N,L)) {
+    return false;
+  }
+
+  const permutation_table_header H = make_permutation_table_header<N,L,IDX>(TABLE.size());
+  FILE* F = fopen(PATH,"wb");
+  if (F == NULL) {
+    return false;
+  }
+
+  const char PAD[UPERM_TABLE_ALIGN] = {0};
+  bool OK = fwrite(&H,sizeof(H),1,F) == 1 &&
+            fwrite(PAD,1,H.DATA_OFFSET - sizeof(H),F) == H.DATA_OFFSET - sizeof(H) &&
+            fwrite(TABLE.data(),sizeof(index_permutation_list<L,IDX>),TABLE.size(),F) == TABLE.size();
+  OK = (fclose(F) == 0) && OK;
+  return OK;
+}
+
+#ifdef UPERM_HAVE_MMAP
+
+/*
+  read-only, zero copy view of a table file, with the same begin/end/size/
+  operator[] interface as index_permutation_list_vector<N,L,IDX>. The
+  mapping is MAP_SHARED, so the entries live in the shared page cache.
+  Move only, unmaps on destruction.
+*/
+template<int N, int L, typename IDX = size_t>
+class mapped_permutation_table {
+public:
+  using value_type = index_permutation_list<L,IDX>;
+  using const_iterator = const value_type*;
+  using iterator = const_iterator;
+
+  mapped_permutation_table() : BASE(NULL), BYTES(0), ENTRIES(NULL), COUNT(0) {}
+  explicit mapped_permutation_table(const char* PATH) : mapped_permutation_table() {
+    open(PATH);
+  }
+  mapped_permutation_table(const mapped_permutation_table&) = delete;
+  mapped_permutation_table& operator=(const mapped_permutation_table&) = delete;
+  mapped_permutation_table(mapped_permutation_table&& OTHER) : mapped_permutation_table() {
+    swap(OTHER);
+  }
+  mapped_permutation_table& operator=(mapped_permutation_table&& OTHER) {
+    close();
+    swap(OTHER);
+    return *this;
+  }
+  ~mapped_permutation_table() {
+    close();
+  }
+
+  //maps PATH, returns false (and stays closed) if it is missing or not a N,L,IDX table
+  bool open(const char* PATH) {
+    close();
+    const int FD = ::open(PATH,O_RDONLY);
+    if (FD < 0) {
+      return false;
+    }
+
+    struct stat ST;
+    if (fstat(FD,&ST) != 0 || ST.st_size < static_cast<off_t>(sizeof(permutation_table_header))) {
+      ::close(FD);
+      return false;
+    }
+
+    const size_t FILE_BYTES = static_cast<size_t>(ST.st_size);
+    void* P = mmap(NULL,FILE_BYTES,PROT_READ,MAP_SHARED,FD,0);
+    ::close(FD);
+    if (P == MAP_FAILED) {
+      return false;
+    }
+
+    const permutation_table_header* H = static_cast<const permutation_table_header*>(P);
+    if (!check_permutation_table_header<N,L,IDX>(*H,FILE_BYTES)) {
+      munmap(P,FILE_BYTES);
+      return false;
+    }
+
+    BASE = P;
+    BYTES = FILE_BYTES;
+    ENTRIES = reinterpret_cast<const value_type*>(static_cast<const char*>(P) + H->DATA_OFFSET);
+    COUNT = H->COUNT;
+    return true;
+  }
+
+  void close() {
+    if (BASE != NULL) {
+      munmap(BASE,BYTES);
+    }
+    BASE = NULL;
+    BYTES = 0;
+    ENTRIES = NULL;
+    COUNT = 0;
+  }
+
+  void swap(mapped_permutation_table& OTHER) {
+    std::swap(BASE,OTHER.BASE);
+    std::swap(BYTES,OTHER.BYTES);
+    std::swap(ENTRIES,OTHER.ENTRIES);
+    std::swap(COUNT,OTHER.COUNT);
+  }
+
+  bool is_open() const { return BASE != NULL; }
+  const_iterator begin() const { return ENTRIES; }
+  const_iterator end() const { return ENTRIES + COUNT; }
+  const value_type* data() const { return ENTRIES; }
+  const value_type& operator[](const size_t K) const { return ENTRIES[K]; }
+  size_t size() const { return COUNT; }
+  bool empty() const { return COUNT == 0; }
+
+private:
+  void* BASE;
+  size_t BYTES;
+  const value_type* ENTRIES;
+  size_t COUNT;
+};
+
+#endif //UPERM_HAVE_MMAP
+
+} //end of namespace
+
+#endif //UPERM_MMAP_H
@@ -0,0 +1,375 @@
+/*  uperm_tensor.h
+
+  Tensor kernels driven by the unique permutation lists of uperm.h, for
+  tensors of N axes.
+
+  antisymmetrize_accumulate adds the signed sum of all axis permutations
+  of a D^N tensor to OUT,
+
+    OUT += ALPHA * sum_L (-1)^L sum_{PLIST at level L} permute(PLIST,IN)
+
+  where permute(PLIST,IN) moves input axis M[k] to output axis k, M being
+  execute_permutations(PLIST,{0,1,...,N-1}) (numpy's transpose(IN,M)).
+
+  Parallelized with OpenMP when compiled with it (_OPENMP).
+
+  transpose_axes applies one list to the axes of a strided tensor of any
+  extents, with the same axis convention.
+*/
+
+#ifndef UPERM_TENSOR_H
+#define UPERM_TENSOR_H
+
+#include "uperm.h"
+
+namespace uperm {
+
+/*
+  one term of the antisymmetrizer: the input strides seen along the
+  output axes, and the signed scale
+*/
+template<int N, typename T>
+struct signed_axis_permutation {
+  std::array<size_t,N> STRIDES;
+  T SCALE;
+};
+
+/*
+  the N! terms of ALPHA times the antisymmetrizer of a D^N tensor, level
+  by level. Term K reads input element sum_k i_k * STRIDES[k] for output
+  element (i_0,...,i_{N-1})
+*/
+template<int N, typename T>
+std::vector<signed_axis_permutation<N,T>> get_antisymmetrizer_terms(const size_t D, const T ALPHA) {
+  std::array<size_t,N> STRIDE;
+  size_t S = 1;
+  for (size_t K=N; K > 0; K--) {
+    STRIDE[K-1] = S;
+    S *= D;
+  }
+
+  std::vector<signed_axis_permutation<N,T>> TERMS;
+  for (size_t L=0; L < static_cast<size_t>(N); L++) {
+    const T SCALE = (L % 2 == 0) ? ALPHA : -ALPHA;
+    for (auto const& PLIST : get_all_unique_permutations<uint8_t>(N,L)) {
+      std::array<size_t,N> AXES;
+      for (size_t K=0; K < AXES.size(); K++) {
+        AXES[K] = K;
+      }
+      AXES = execute_permutations(PLIST,AXES);
+
+      signed_axis_permutation<N,T> TERM;
+      for (size_t K=0; K < AXES.size(); K++) {
+        TERM.STRIDES[K] = STRIDE[AXES[K]];
+      }
+      TERM.SCALE = SCALE;
+      TERMS.push_back(TERM);
+    }
+  }
+  return TERMS;
+}
+
+/*
+  edge of the blocks of antisymmetrize_accumulate: the largest one whose
+  E^N block of T fits UPERM_ANTISYMMETRIZE_BLOCK_BYTES, but never 
+  shorter than a cache line of T (or D). Along the last axis blocks are
+  at least UPERM_ANTISYMMETRIZE_ROW long, which keeps the per row
+  overhead low
+*/
+#ifndef UPERM_ANTISYMMETRIZE_BLOCK_BYTES
+#define UPERM_ANTISYMMETRIZE_BLOCK_BYTES (256*1024)
+#endif
+#ifndef UPERM_ANTISYMMETRIZE_ROW
+#define UPERM_ANTISYMMETRIZE_ROW 32
+#endif
+
+template<int N, typename T>
+size_t antisymmetrize_block_edge(const size_t D) {
+  const size_t LINE = std::max<size_t>(1,64 / sizeof(T));
+  size_t E = 1;
+  for (;;) {
+    size_t BYTES = sizeof(T);
+    for (int K=0; K < N && BYTES <= UPERM_ANTISYMMETRIZE_BLOCK_BYTES; K++) {
+      BYTES *= E + 1;
+    }
+    if (BYTES > UPERM_ANTISYMMETRIZE_BLOCK_BYTES || E >= D) {
+      break;
+    }
+    E++;
+  }
+  return std::min(std::max(E,LINE),D);
+}
+
+/*
+  OUT += ALPHA * antisymmetrizer(IN) for D^N row-major tensors IN and OUT
+  (which must not overlap).
+
+  Instead of materializing each permuted tensor, the output is cut into
+  blocks of TILE indices along every axis (TILE = 0 picks 
+  antisymmetrize_block_edge) and every term is accumulated into a block
+  while it is in cache, so OUT is read and written once. Blocking all 
+  axes also blocks the input: whichever output axis B a term maps the 
+  contiguous input axis to, the block spans at least a cache line along
+  it, and the term walks B right inside its rows, so each input line is
+  used by consecutive rows instead of being fetched once per element.
+  A term that keeps the last axis in place reads the input with unit
+  stride, which vectorizes. Blocks are independent and are spread over
+  the OpenMP threads.
+*/
+template<int N, typename T>
+void antisymmetrize_accumulate(const T* IN, T* OUT, const size_t D, const T ALPHA = T(1),
+                               size_t TILE = 0) {
+  static_assert(N >= 1, "the tensor needs at least one axis");
+  if (D == 0) {
+    return;
+  }
+  if (TILE == 0) {
+    TILE = antisymmetrize_block_edge<N,T>(D);
+  }
+
+  const std::vector<signed_axis_permutation<N,T>> TERMS = get_antisymmetrizer_terms<N,T>(D,ALPHA);
+
+  /*
+    order of the leading axes in which each term walks the rows of a 
+    block, fastest last. The axis that reads the input with unit stride
+    goes fastest, so consecutive rows read the neighbouring elements of
+    the cache lines the previous rows fetched
+  */
+  std::vector<std::array<size_t,N>> ORDER(TERMS.size());
+  for (size_t TK=0; TK < TERMS.size(); TK++) {
+    size_t P = 0;
+    for (size_t K=0; K + 1 < static_cast<size_t>(N); K++) {
+      if (TERMS[TK].STRIDES[K] != 1) {
+        ORDER[TK][P++] = K;
+      }
+    }
+    for (size_t K=0; K + 1 < static_cast<size_t>(N); K++) {
+      if (TERMS[TK].STRIDES[K] == 1) {
+        ORDER[TK][P++] = K;
+      }
+    }
+  }
+
+  std::array<size_t,N> OUT_STRIDE;
+  size_t S = 1;
+  for (size_t K=N; K > 0; K--) {
+    OUT_STRIDE[K-1] = S;
+    S *= D;
+  }
+
+  //the last axis is cut in longer rows, which keeps the per row overhead low
+  const size_t ROW = std::min(D,std::max<size_t>(TILE,UPERM_ANTISYMMETRIZE_ROW));
+  const size_t NB = (D + TILE - 1) / TILE;
+  const size_t NB_LAST = (D + ROW - 1) / ROW;
+  size_t NBLOCKS = NB_LAST;
+  for (size_t K=0; K + 1 < static_cast<size_t>(N); K++) {
+    NBLOCKS *= NB;
+  }
+  const long long NWORK = static_cast<long long>(NBLOCKS);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+  for (long long W=0; W < NWORK; W++) {
+    //index range of the block along each axis
+    std::array<size_t,N> LO;
+    std::array<size_t,N> HI;
+    size_t REST = static_cast<size_t>(W);
+    LO[N-1] = (REST % NB_LAST) * ROW;
+    HI[N-1] = std::min(LO[N-1] + ROW,D);
+    REST /= NB_LAST;
+    for (size_t K=N-1; K > 0; K--) {
+      LO[K-1] = (REST % NB) * TILE;
+      HI[K-1] = std::min(LO[K-1] + TILE,D);
+      REST /= NB;
+    }
+    const size_t J0 = LO[N-1];
+    const size_t J1 = HI[N-1];
+
+    for (size_t TK=0; TK < TERMS.size(); TK++) {
+      const signed_axis_permutation<N,T>& TERM = TERMS[TK];
+      const std::array<size_t,N>& ORD = ORDER[TK];
+      const size_t SJ = TERM.STRIDES[N-1];
+      const T SCALE = TERM.SCALE;
+
+      //rows of the block, over the leading N-1 axes in ORD
+      std::array<size_t,N> I = LO;
+      size_t IN_OFFSET = 0;
+      size_t OUT_OFFSET = 0;
+      for (size_t K=0; K + 1 < static_cast<size_t>(N); K++) {
+        IN_OFFSET += LO[K] * TERM.STRIDES[K];
+        OUT_OFFSET += LO[K] * OUT_STRIDE[K];
+      }
+      for (;;) {
+        T* OUT_ROW = OUT + OUT_OFFSET;
+        const T* IN_ROW = IN + IN_OFFSET;
+        if (SJ == 1) {
+          for (size_t J=J0; J < J1; J++) {
+            OUT_ROW[J] += SCALE * IN_ROW[J];
+          }
+        } else {
+          for (size_t J=J0; J < J1; J++) {
+            OUT_ROW[J] += SCALE * IN_ROW[J * SJ];
+          }
+        }
+
+        size_t K = N - 1;
+        for (; K > 0; K--) {
+          const size_t X = ORD[K-1];
+          I[X]++;
+          IN_OFFSET += TERM.STRIDES[X];
+          OUT_OFFSET += OUT_STRIDE[X];
+          if (I[X] < HI[X]) {
+            break;
+          }
+          IN_OFFSET -= (I[X] - LO[X]) * TERM.STRIDES[X];
+          OUT_OFFSET -= (I[X] - LO[X]) * OUT_STRIDE[X];
+          I[X] = LO[X];
+        }
+        if (K == 0) {
+          break;
+        }
+      }
+    }
+  }
+}
+
+/*
+  Axis permutation (tensor transpose)
+
+  OUT axis k is IN axis MAP[k]: OUT(i_0,...,i_{N-1}) = IN(j) with 
+  j_{MAP[k]} = i_k. EXTENTS and IN_STRIDES describe IN, OUT_STRIDES the
+  output, all strides counted in elements.
+
+  The fastest output axis A (the last) and the output axis B that is 
+  fastest in the input are copied in TILE x TILE blocks, so both sides
+  are walked along cache lines; the remaining axes are an outer loop.
+  When the last axis stays in place and is contiguous on both sides,
+  A == B and each row is a single contiguous (vectorized) copy.
+*/
+template<int N, typename T>
+void transpose_axes_map(const std::array<size_t,N>& MAP, const T* IN,
+                        const std::array<size_t,N>& EXTENTS, const std::array<size_t,N>& IN_STRIDES,
+                        T* OUT, const std::array<size_t,N>& OUT_STRIDES, const size_t TILE = 32) {
+  static_assert(N >= 1, "the tensor needs at least one axis");
+
+  //extents and input strides along the output axes
+  std::array<size_t,N> E;
+  std::array<size_t,N> IS;
+  for (size_t K=0; K < E.size(); K++) {
+    E[K] = EXTENTS[MAP[K]];
+    IS[K] = IN_STRIDES[MAP[K]];
+    if (E[K] == 0) {
+      return;
+    }
+  }
+  const std::array<size_t,N>& OS = OUT_STRIDES;
+
+  const size_t A = N - 1;
+  size_t B = A;
+  for (size_t K=0; K < E.size(); K++) {
+    if (IS[K] < IS[B]) {
+      B = K;
+    }
+  }
+
+  std::array<size_t,N> I{};
+  size_t IN_OFFSET = 0;
+  size_t OUT_OFFSET = 0;
+  for (;;) {
+    if (A == B) {
+      const T* SRC = IN + IN_OFFSET;
+      T* DST = OUT + OUT_OFFSET;
+      if (IS[A] == 1 && OS[A] == 1) {
+        std::copy(SRC,SRC + E[A],DST);
+      } else {
+        for (size_t J=0; J < E[A]; J++) {
+          DST[J*OS[A]] = SRC[J*IS[A]];
+        }
+      }
+    } else {
+      for (size_t I0=0; I0 < E[B]; I0 += TILE) {
+        const size_t I1 = std::min(I0 + TILE,E[B]);
+        for (size_t J0=0; J0 < E[A]; J0 += TILE) {
+          const size_t J1 = std::min(J0 + TILE,E[A]);
+          for (size_t II=I0; II < I1; II++) {
+            const T* SRC = IN + IN_OFFSET + II*IS[B];
+            T* DST = OUT + OUT_OFFSET + II*OS[B];
+            for (size_t J=J0; J < J1; J++) {
+              DST[J*OS[A]] = SRC[J*IS[A]];
+            }
+          }
+        }
+      }
+    }
+
+    //next index of the outer axes, last one fastest
+    size_t K = N;
+    for (; K > 0; K--) {
+      const size_t X = K - 1;
+      if (X == A || X == B) {
+        continue;
+      }
+      I[X]++;
+      IN_OFFSET += IS[X];
+      OUT_OFFSET += OS[X];
+      if (I[X] < E[X]) {
+        break;
+      }
+      IN_OFFSET -= I[X]*IS[X];
+      OUT_OFFSET -= I[X]*OS[X];
+      I[X] = 0;
+    }
+    if (K == 0) {
+      return;
+    }
+  }
+}
+
+//the axis map of PLIST, a fixed size or runtime length list
+template<int N, typename Plist>
+std::array<size_t,N> compose_axis_map(const Plist& PLIST) {
+  std::array<size_t,N> MAP;
+  for (size_t K=0; K < MAP.size(); K++) {
+    MAP[K] = K;
+  }
+  for (auto const& perm : PLIST) {
+    std::swap(MAP[perm.first],MAP[perm.second]);
+  }
+  return MAP;
+}
+
+//row-major strides of a dense tensor
+template<int N>
+std::array<size_t,N> dense_strides(const std::array<size_t,N>& EXTENTS) {
+  std::array<size_t,N> STRIDES;
+  size_t S = 1;
+  for (size_t K=N; K > 0; K--) {
+    STRIDES[K-1] = S;
+    S *= EXTENTS[K-1];
+  }
+  return STRIDES;
+}
+
+//OUT = IN with its axes permuted by PLIST, for strided IN and OUT
+template<int N, typename Plist, typename T>
+void transpose_axes(const Plist& PLIST, const T* IN,
+                    const std::array<size_t,N>& EXTENTS, const std::array<size_t,N>& IN_STRIDES,
+                    T* OUT, const std::array<size_t,N>& OUT_STRIDES, const size_t TILE = 32) {
+  transpose_axes_map<N>(compose_axis_map<N>(PLIST),IN,EXTENTS,IN_STRIDES,OUT,OUT_STRIDES,TILE);
+}
+
+//as above, for dense row-major IN (of EXTENTS) and OUT (of the permuted extents)
+template<int N, typename Plist, typename T>
+void transpose_axes(const Plist& PLIST, const T* IN, const std::array<size_t,N>& EXTENTS, T* OUT) {
+  const std::array<size_t,N> MAP = compose_axis_map<N>(PLIST);
+  std::array<size_t,N> OUT_EXTENTS;
+  for (size_t K=0; K < MAP.size(); K++) {
+    OUT_EXTENTS[K] = EXTENTS[MAP[K]];
+  }
+  transpose_axes_map<N>(MAP,IN,EXTENTS,dense_strides<N>(EXTENTS),OUT,dense_strides<N>(OUT_EXTENTS));
+}
+
+} //end of namespace
+
+#endif //UPERM_TENSOR_H